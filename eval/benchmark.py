@@ -343,12 +343,32 @@ torture_benchmarks = [
     },
 ]
 
+# <num_iterations> <working_set_size> <transfer_size>, the working set should
+# fit in the host's last level cache
+cache_disturb_benchmarks = [
+    {
+        "name": "cache_disturb",
+        "directory": f"{eval_dir}/src/cache_disturb",
+        "commands": [
+            "./cache_disturb 16 8388608 33554432",
+            "./cache_disturb 16 8388608 67108864",
+            "./cache_disturb 16 8388608 134217728",
+            "./cache_disturb 16 8388608 268435456",
+            "./cache_disturb 16 8388608 536870912",
+            "./cache_disturb 16 8388608 1073741824",
+        ],
+        "regex": r"Slowdown:\s*([\d.]+)",
+        "unit": "",
+    },
+]
+
 hashes = ["CityHash32", "CityHash64", "CityHash128", "CityHashCrc128",
           "FarmHash32", "FarmHash64", "FarmHash128",
           "MeowHash",
           "rapidhash",
           "t1ha0_ia32aes_avx", "t1ha0_ia32aes_avx2", "t1ha0_ia32aes_noavx", "t1ha0_32le", "t1ha1_le", "t1ha2_atonce",
           "XXH32", "XXH64", "XXH3_64bits", "XXH3_128bits",
+          "CRC32C_x8", "CRC32C_x8_sse42", "CRC32C_x8_avx2", "CRC32C_x8_avx512",
 ]
 
 def run_benchmark(directory, command, regexes, unit, profiler_cmd, warmup_cnt, run_cnt, confidence):
@@ -435,21 +455,11 @@ def run_benchmark(directory, command, regexes, unit, profiler_cmd, warmup_cnt, r
     sys.stdout.flush()
     return times
 
-def build(CMAKE_BUILD_TYPE='Release',
-          ENABLE_COLLISION_CHECKING='OFF',
-          MEASURE_HASHING_OVERHEAD='OFF',
-          HASH_FUNCTION='t1ha0_ia32aes_avx2',
-          PRINT_TRANSFER_RATE='OFF',
-          PRINT_SPACE_OVERHEAD='OFF'):
+def build(CMAKE_BUILD_TYPE='Release'):
     current_dir = os.getcwd()
     os.chdir(build_dir)
     cmake_command = ["cmake", "..", 
                      f"-DCMAKE_BUILD_TYPE=\'{CMAKE_BUILD_TYPE}\'", 
-                     f"-DENABLE_COLLISION_CHECKING={ENABLE_COLLISION_CHECKING}", 
-                     f"-DMEASURE_HASHING_OVERHEAD={MEASURE_HASHING_OVERHEAD}", 
-                     f"-DHASH_FUNCTION=\'{HASH_FUNCTION}\'",
-                     f"-DPRINT_TRANSFER_RATE={PRINT_TRANSFER_RATE}", 
-                     f"-DPRINT_SPACE_OVERHEAD={PRINT_SPACE_OVERHEAD}", 
                      ]
     make_command = ["make", "-j"]
 
@@ -587,23 +597,25 @@ def benchmark_hash_overhead():
     confidence = 0.95
     # Collect execution times and compute averages
     results = defaultdict(lambda: defaultdict(lambda: defaultdict(lambda: None)))
+    # every hash function is built in, select one at runtime
+    success = build()
+    if (not success):
+        return
     for hash_fn in hashes:
-        success = build(MEASURE_HASHING_OVERHEAD='ON',
-                        HASH_FUNCTION=hash_fn)
-        if (not success):
-            continue
+        hash_profiler_command = f"OMPDATAPERF_HASH={hash_fn} {profiler_command} --measure-hashing"
 
         for benchmark in benchmarks:
             name = benchmark["name"]
             if "(fix)" in name or "(syn)" in name:
                 continue
             directory = benchmark["directory"]
-            regex = [r"avg hash rate\s*([\d.]+)(GB/s)"]
+            # only match runs that used the requested hash function
+            regex = [rf"hash function\s+{re.escape(hash_fn)} \([\s\S]*avg hash rate\s*([\d.]+)(GB/s)"]
             unit = "GB/s"
     
-            small_times_prof = run_benchmark(directory, benchmark["commands"][0], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
-            medium_times_prof = run_benchmark(directory, benchmark["commands"][1], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
-            large_times_prof = run_benchmark(directory, benchmark["commands"][2], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
+            small_times_prof = run_benchmark(directory, benchmark["commands"][0], regex, unit, hash_profiler_command, warmup_runs, repetitions, confidence)
+            medium_times_prof = run_benchmark(directory, benchmark["commands"][1], regex, unit, hash_profiler_command, warmup_runs, repetitions, confidence)
+            large_times_prof = run_benchmark(directory, benchmark["commands"][2], regex, unit, hash_profiler_command, warmup_runs, repetitions, confidence)
         
             results["small"][hash_fn][name] = mean(small_times_prof[0])
             results["medium"][hash_fn][name] = mean(medium_times_prof[0])
@@ -641,24 +653,26 @@ def benchmark_hash_overhead_torture():
 
     # Collect execution times and compute averages
     results = defaultdict(lambda: defaultdict(lambda: defaultdict(lambda: None)))
+    # every hash function is built in, select one at runtime
+    success = build()
+    if (not success):
+        return
     for hash_fn in hashes:
-        success = build(MEASURE_HASHING_OVERHEAD='ON',
-                        HASH_FUNCTION=hash_fn)
-        if (not success):
-            continue
+        hash_profiler_command = f"OMPDATAPERF_HASH={hash_fn} {profiler_command} --measure-hashing"
 
         for benchmark in torture_benchmarks:
             name = benchmark["name"]
             if "(fix)" in name:
                 continue
             directory = benchmark["directory"]
-            regex = [r"avg hash rate\s*([\d.]+)(GB/s)"]
+            # only match runs that used the requested hash function
+            regex = [rf"hash function\s+{re.escape(hash_fn)} \([\s\S]*avg hash rate\s*([\d.]+)(GB/s)"]
             unit = "GB/s"
     
             for command in benchmark["commands"]: 
                 numbers = re.findall(r'\d+', command)
                 size = numbers[-1] if numbers else 0
-                times_prof = run_benchmark(directory, command, regex, unit, profiler_command, warmup_runs, repetitions, confidence)
+                times_prof = run_benchmark(directory, command, regex, unit, hash_profiler_command, warmup_runs, repetitions, confidence)
                 results[size][hash_fn][name] = mean(times_prof[0])
                 print(f"  result ({size})  : {results[size][hash_fn][name]:<20.3f}")
     
@@ -690,11 +704,12 @@ def benchmark_hash_collisions():
     confidence = 0.00
     # Collect execution times and compute averages
     results = defaultdict(lambda: defaultdict(lambda: defaultdict(lambda: None)))
+    # every hash function is built in, select one at runtime
+    success = build()
+    if (not success):
+        return
     for hash_fn in hashes:
-        success = build(ENABLE_COLLISION_CHECKING='ON',
-                        HASH_FUNCTION=hash_fn)
-        if (not success):
-            continue
+        hash_profiler_command = f"OMPDATAPERF_HASH={hash_fn} {profiler_command} --check-collisions"
 
         for benchmark in benchmarks:
             name = benchmark["name"]
@@ -702,12 +717,12 @@ def benchmark_hash_collisions():
                 continue
             directory = benchmark["directory"]
             #regex = r"collision rate of\s+([\d.]+)%"
-            regex = [r"Found\s+([\d.]+) collisions"]
+            regex = [rf"hash function\s+{re.escape(hash_fn)} \([\s\S]*Found\s+([\d.]+) collisions"]
             unit = ""
     
-            small_times_prof = run_benchmark(directory, benchmark["commands"][0], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
-            medium_times_prof = run_benchmark(directory, benchmark["commands"][1], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
-            large_times_prof = run_benchmark(directory, benchmark["commands"][2], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
+            small_times_prof = run_benchmark(directory, benchmark["commands"][0], regex, unit, hash_profiler_command, warmup_runs, repetitions, confidence)
+            medium_times_prof = run_benchmark(directory, benchmark["commands"][1], regex, unit, hash_profiler_command, warmup_runs, repetitions, confidence)
+            large_times_prof = run_benchmark(directory, benchmark["commands"][2], regex, unit, hash_profiler_command, warmup_runs, repetitions, confidence)
         
             results["small"][hash_fn][name] = mean(small_times_prof[0])
             results["medium"][hash_fn][name] = mean(medium_times_prof[0])
@@ -957,7 +972,8 @@ def benchmark_transfer_rate_torture():
 
     # Collect execution times and compute averages
     results = defaultdict(lambda: defaultdict(lambda: None))
-    success = build(PRINT_TRANSFER_RATE='ON')
+    success = build()
+    rate_profiler_command = f"{profiler_command} --print-transfer-rate"
     for benchmark in torture_benchmarks:
         name = benchmark["name"]
         if "(fix)" in name:
@@ -969,7 +985,7 @@ def benchmark_transfer_rate_torture():
         for command in benchmark["commands"]: 
             numbers = re.findall(r'\d+', command)
             size = numbers[-1] if numbers else 0
-            times_prof = run_benchmark(directory, command, regex, unit, profiler_command, warmup_runs, repetitions, confidence)
+            times_prof = run_benchmark(directory, command, regex, unit, rate_profiler_command, warmup_runs, repetitions, confidence)
             results[size][name] = mean(times_prof[0])
             print(f"  result ({size})  : {results[size][name]:<20.3f}")
     
@@ -994,6 +1010,53 @@ def benchmark_transfer_rate_torture():
         print()
 
 
+def benchmark_cache_disturbance():
+    warmup_runs = 1
+    repetitions = 5
+    confidence = 0.00
+
+    # Slowdown of a hot working set after each transfer, without the profiler
+    # and with the profiler hashing through the caches or streaming past them
+    results = defaultdict(lambda: defaultdict(lambda: None))
+    success = build()
+    if (not success):
+        return
+    configs = {
+        "no profiler": "",
+        "cached hash": f"OMPDATAPERF_STREAMING_HASH=0 {profiler_command}",
+        "streaming hash": f"OMPDATAPERF_STREAMING_HASH=1 {profiler_command}",
+    }
+    for benchmark in cache_disturb_benchmarks:
+        name = benchmark["name"]
+        directory = benchmark["directory"]
+        regex = [benchmark["regex"]]
+        unit = benchmark["unit"]
+
+        for command in benchmark["commands"]:
+            numbers = re.findall(r'\d+', command)
+            size = numbers[-1] if numbers else 0
+            for config, config_command in configs.items():
+                slowdowns = run_benchmark(directory, command, regex, unit, config_command, warmup_runs, repetitions, confidence)
+                results[size][config] = mean(slowdowns[0])
+                print(f"  result ({size}, {config}) : {results[size][config]:<20.3f}")
+
+    for benchmark in cache_disturb_benchmarks:
+        print(f"RESULTS - Cache Disturbance - ({benchmark['name']}) - slowdown")
+        header = f"{'Input Size':<15}\t"
+        for config in configs:
+            header += f"{config:<20}\t"
+        print(header)
+
+        for command in benchmark["commands"]:
+            numbers = re.findall(r'\d+', command)
+            size = numbers[-1] if numbers else 0
+            row = f"{size:<15}\t"
+            for config in configs:
+                row += f"{results[size][config]:<20.3f}\t"
+            print(row)
+        print()
+
+
 def benchmark_runtime_overhead_full():
     warmup_runs = 5
     repetitions = 10
@@ -1066,7 +1129,8 @@ def benchmark_space_overhead():
     confidence = 0.95
     # Collect execution times and compute averages
     results = defaultdict(lambda: defaultdict(lambda: None))
-    success = build(PRINT_SPACE_OVERHEAD='ON')
+    success = build()
+    space_profiler_command = f"{profiler_command} --print-space-overhead"
     if (not success):
         return
 
@@ -1078,9 +1142,9 @@ def benchmark_space_overhead():
         regex = [r"  space overhead \(B\)\s*([\d.]+)"]
         unit = ""
     
-        small_times_prof = run_benchmark(directory, benchmark["commands"][0], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
-        medium_times_prof = run_benchmark(directory, benchmark["commands"][1], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
-        large_times_prof = run_benchmark(directory, benchmark["commands"][2], regex, unit, profiler_command, warmup_runs, repetitions, confidence)
+        small_times_prof = run_benchmark(directory, benchmark["commands"][0], regex, unit, space_profiler_command, warmup_runs, repetitions, confidence)
+        medium_times_prof = run_benchmark(directory, benchmark["commands"][1], regex, unit, space_profiler_command, warmup_runs, repetitions, confidence)
+        large_times_prof = run_benchmark(directory, benchmark["commands"][2], regex, unit, space_profiler_command, warmup_runs, repetitions, confidence)
         
         results["small"][name] = mean(small_times_prof[0])
         results["medium"][name] = mean(medium_times_prof[0])
@@ -1117,5 +1181,6 @@ def benchmark_space_overhead():
 #benchmark_hash_overhead_torture()
 #benchmark_runtime_overhead_torture()
 #benchmark_transfer_rate_torture()
+#benchmark_cache_disturbance()
 #benchmark_hash_collisions()
 benchmark_space_overhead()
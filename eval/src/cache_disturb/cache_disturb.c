@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <omp.h>
+
+// Measures how much transferring a large buffer to the device disturbs the
+// host caches. A small working set is traversed once while it is hot and once
+// right after each transfer, the difference being the time spent refetching
+// whatever the transfer (and the profiler hashing it) evicted.
+
+#define LINE_BYTES 64
+
+typedef struct line {
+  size_t next;
+  char pad[LINE_BYTES - sizeof(size_t)];
+} line_t;
+
+void usage(int argc, char **argv) {
+  fprintf(stderr,
+          "Usage: %s <num_iterations> <working_set_size> <transfer_size>\n",
+          argv[0]);
+}
+
+// Links the lines into a single random cycle so that the traversal defeats the
+// hardware prefetchers (Sattolo's algorithm).
+void link_lines(line_t *lines, size_t num_lines) {
+  for (size_t i = 0; i < num_lines; ++i) {
+    lines[i].next = i;
+  }
+  srand(42);
+  for (size_t i = num_lines - 1; i > 0; --i) {
+    const size_t j = (((size_t)rand() << 31) ^ (size_t)rand()) % i;
+    const size_t tmp = lines[i].next;
+    lines[i].next = lines[j].next;
+    lines[j].next = tmp;
+  }
+}
+
+size_t traverse(const line_t *lines, size_t num_lines) {
+  size_t i = 0;
+  for (size_t n = 0; n < num_lines; ++n) {
+    i = lines[i].next;
+  }
+  return i;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    usage(argc, argv);
+    exit(1);
+  }
+
+  const long long num_iterations = atoll(argv[1]);
+  const size_t num_lines = atoll(argv[2]) / LINE_BYTES;
+  const size_t transfer_size = atoll(argv[3]) / sizeof(uint64_t);
+  if (num_lines < 2 || transfer_size == 0) {
+    usage(argc, argv);
+    exit(1);
+  }
+
+  line_t *lines = (line_t *)aligned_alloc(LINE_BYTES, num_lines * LINE_BYTES);
+  link_lines(lines, num_lines);
+  // not constant, so that the profiler has to hash it
+  uint64_t *a = (uint64_t *)malloc(transfer_size * sizeof(*a));
+  for (size_t i = 0; i < transfer_size; ++i) {
+    a[i] = i * UINT64_C(0x9e3779b97f4a7c15);
+  }
+
+  double hot_time = 0.0;
+  double disturbed_time = 0.0;
+  size_t sink = 0;
+  for (long long iter = 0; iter < num_iterations; ++iter) {
+    // warm up
+    sink += traverse(lines, num_lines);
+    double start_time = omp_get_wtime();
+    sink += traverse(lines, num_lines);
+    hot_time += omp_get_wtime() - start_time;
+
+    a[iter % transfer_size] += 1; // so that no transfer is a duplicate
+    #pragma omp target enter data map(to:a[0:transfer_size])
+    #pragma omp target exit data map(release:a[0:transfer_size])
+
+    start_time = omp_get_wtime();
+    sink += traverse(lines, num_lines);
+    disturbed_time += omp_get_wtime() - start_time;
+  }
+
+  printf("Checksum: %zu\n", sink);
+  printf("Hot traversal time: %f seconds\n", hot_time);
+  printf("Disturbed traversal time: %f seconds\n", disturbed_time);
+  printf("Slowdown: %f\n", disturbed_time / hot_time);
+
+  free(a);
+  free(lines);
+  return 0;
+}
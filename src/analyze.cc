@@ -1,5 +1,6 @@
 #include "analyze.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
@@ -8,18 +9,22 @@
 #include <iostream>
 #include <map>
 #include <sstream>
+#include <unordered_map>
+
+#include "hasher.hh"
 
 using namespace std::chrono;
 
 // OUTPUT FORMATTING CONSTANTS
 // max maximum number of profiling results to display
-constexpr size_t f_list_len = 24;
-constexpr size_t f_sublist_len = 8; // max length sub lists
+size_t f_list_len = 24;
+size_t f_sublist_len = 8; // max length sub lists
 // column widths
 constexpr int f_w = 10;           // column width
 constexpr int f_w_bytes = 13;     // column width for bytes
 constexpr int f_w_device_id = 13; // column width for device ids
 constexpr int f_w_optype = 21;    // column width for optype
+constexpr int f_w_pattern = 20;   // column width for constant values
 
 float round_to(float value, float precision = 1.0) {
   return std::roundf(value / precision) * precision;
@@ -137,6 +142,36 @@ std::string format_symbol(Symbolizer &symbolizer, const void *codeptr_ra) {
   return oss.str();
 }
 
+/* Formats the value repeated by constant data as the shortest element that
+ * repeats, e.g. 0x3f800000 for an array of 1.0f.
+ */
+std::string format_pattern(uint64_t pattern, int width) {
+  assert(width > 18);
+  // elements of 1, 2 or 4 bytes repeat if shifting by one element is the same
+  // as truncating by one
+  int element_bytes = 1;
+  while (element_bytes < 8) {
+    const int shift = 8 * element_bytes;
+    if ((pattern >> shift) == (pattern & (~UINT64_C(0) >> shift))) {
+      break;
+    }
+    element_bytes *= 2;
+  }
+  const uint64_t element =
+      element_bytes == 8 ? pattern
+                         : pattern & ((UINT64_C(1) << (8 * element_bytes)) - 1);
+  std::ostringstream hex;
+  if (element == 0) {
+    hex << "0";
+  } else {
+    hex << "0x" << std::hex << std::setw(2 * element_bytes) << std::setfill('0')
+        << element;
+  }
+  std::ostringstream oss;
+  oss << std::setw(width) << hex.str();
+  return oss.str();
+}
+
 std::string format_device_num(int num_devices, int device_num, int width) {
   assert(width > 9);
   std::ostringstream oss;
@@ -549,6 +584,295 @@ void print_unused_transfers(
   return;
 }
 
+void print_constant_transfers(
+    Symbolizer &symbolizer,
+    const std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
+                             std::vector<const data_op_info_t *>>>
+        &constant_transfer_durations,
+    duration<uint64_t, std::nano> exec_time, int num_devices) {
+
+  std::cerr << "\n=== OpenMP Constant Target Data Transfer Analysis ===\n";
+  if (constant_transfer_durations.empty()) {
+    std::cerr << "  SUCCESS - no constant data transfers detected\n";
+    return;
+  }
+  // clang-format off
+  std::cerr << std::setw(f_w) << "time(%)"
+            << std::setw(f_w) << "time"
+            << std::setw(f_w) << "calls"
+            << std::setw(f_w) << "avg"
+            << std::setw(f_w_bytes) << "bytes"
+            << std::setw(f_w_pattern) << "value"
+            << std::left << std::setw(f_w_device_id) << "  dest device"
+            << std::right << "  location\n";
+  // clang-format on
+  size_t idx = 0;
+  // reverse iterate since we want to display greatest times first
+  for (auto it = constant_transfer_durations.rbegin();
+       it != constant_transfer_durations.rend(); ++it) {
+    if (idx >= f_list_len) {
+      break;
+    }
+    const duration<uint64_t, std::nano> time = it->first;
+    const std::vector<const data_op_info_t *> &info_list = it->second;
+    const float time_percent = time.count() / (float)exec_time.count();
+    const uint64_t calls = info_list.size();
+    const duration<uint64_t, std::nano> time_avg(
+        (uint64_t)std::roundf(time.count() / (float)calls));
+    uint64_t bytes = 0;
+    for (const data_op_info_t *entry_ptr : info_list) {
+      bytes += entry_ptr->bytes;
+    }
+    const data_op_info_t *first_ptr = info_list.front();
+    // clang-format off
+    std::cerr << format_percent(time_percent, f_w)
+              << format_duration(time.count(), f_w)
+              << format_uint(calls, f_w)
+              << format_duration(time_avg.count(), f_w)
+              << format_uint(bytes, f_w_bytes)
+              << format_pattern(first_ptr->hash.low64, f_w_pattern)
+              << format_device_num(num_devices, first_ptr->dest_device_num,
+                                   f_w_device_id)
+              << format_symbol(symbolizer, first_ptr->codeptr_ra)
+              << "\n";
+    // clang-format on
+    ++idx;
+  }
+  std::cerr << "  Each of these transfers copies a single repeated value. "
+               "Mapping the data with\n  map(alloc:) and initializing it on "
+               "the device avoids the transfer.\n";
+  return;
+}
+
+/* Adds the allocations and deletions that are potentially unnecessary to
+ * 'pot_unnecessary_ops' and counts them.
+ */
+void get_pot_unnecessary_allocs(
+    std::set<const data_op_info_t *> &pot_unnecessary_ops,
+    uint64_t &pot_ad_calls, uint64_t &pot_ua_calls,
+    const std::set<
+        std::pair<duration<uint64_t, std::nano> /*total_time*/,
+                  std::vector<std::pair<const data_op_info_t * /*alloc*/,
+                                        const data_op_info_t * /*delete*/>>>>
+        &repeated_alloc_durations,
+    const std::set<
+        std::pair<duration<uint64_t, std::nano> /*total_time*/,
+                  std::vector<std::pair<const data_op_info_t * /*alloc*/,
+                                        const data_op_info_t * /*delete*/>>>>
+        &unused_alloc_durations) {
+  for (auto it = repeated_alloc_durations.rbegin();
+       it != repeated_alloc_durations.rend(); ++it) {
+    // we assume the first allocation and last delete to be unavoidable
+    const std::vector<std::pair<const data_op_info_t *, const data_op_info_t *>>
+        &info_list = it->second;
+    pot_ad_calls += info_list.size() - 1;
+    for (size_t i = 0; i < info_list.size(); ++i) {
+      const data_op_info_t *alloc_ptr = info_list[i].first;
+      const data_op_info_t *delete_ptr = info_list[i].second;
+      if (i != 0) {
+        pot_unnecessary_ops.emplace(alloc_ptr);
+      }
+      if (i != info_list.size() - 1) {
+        pot_unnecessary_ops.emplace(delete_ptr);
+      }
+    }
+  }
+
+  for (auto it = unused_alloc_durations.rbegin();
+       it != unused_alloc_durations.rend(); ++it) {
+    // we assume all unused allocations to be avoidable
+    const std::vector<std::pair<const data_op_info_t *, const data_op_info_t *>>
+        &info_list = it->second;
+    pot_ua_calls += info_list.size();
+    for (size_t i = 0; i < info_list.size(); ++i) {
+      const data_op_info_t *alloc_ptr = info_list[i].first;
+      const data_op_info_t *delete_ptr = info_list[i].second;
+      pot_unnecessary_ops.emplace(alloc_ptr);
+      pot_unnecessary_ops.emplace(delete_ptr);
+    }
+  }
+  return;
+}
+
+/* Estimate of a total over every data transfer, extrapolated from the
+ * sampled transfers, along with the half width of its 95% confidence interval.
+ */
+typedef struct estimate {
+  double total;
+  double margin;
+} estimate_t;
+
+/* Ratio estimate of the total of y over every transfer, given (x, y) for each
+ * sampled transfer and the exact total of x over every transfer. With x = 1
+ * this extrapolates a number of transfers, with x = bytes a number of bytes
+ * and so on.
+ */
+estimate_t estimate_total(const std::vector<std::pair<double, double>> &sample,
+                          double x_total, uint64_t period) {
+  const size_t n = sample.size();
+  double x_sum = 0;
+  double y_sum = 0;
+  for (const auto &[x, y] : sample) {
+    x_sum += x;
+    y_sum += y;
+  }
+  if (n == 0 || x_sum <= 0) {
+    return {0, 0};
+  }
+  const double ratio = y_sum / x_sum;
+  const double total = ratio * x_total;
+  if (n < 2) {
+    return {total, total};
+  }
+
+  double residual_sq_sum = 0;
+  for (const auto &[x, y] : sample) {
+    residual_sq_sum += (y - ratio * x) * (y - ratio * x);
+  }
+  const double x_mean = x_sum / n;
+  const double fpc = 1.0 - 1.0 / period; // finite population correction
+  const double ratio_var =
+      fpc * residual_sq_sum / (n - 1) / (n * x_mean * x_mean);
+  constexpr double z_95 = 1.96;
+  return {total, z_95 * x_total * std::sqrt(ratio_var)};
+}
+
+/* Extrapolates the number of transfers in 'flagged' to every transfer.
+ */
+estimate_t
+estimate_calls(const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+               const std::set<const data_op_info_t *> &flagged,
+               const sampling_info_t *sampling) {
+  std::vector<std::pair<double, double>> sample;
+  for (const data_op_info_t &entry : *data_op_log_ptr) {
+    if (is_transfer_op(entry.optype)) {
+      sample.emplace_back(1.0, flagged.count(&entry));
+    }
+  }
+  return estimate_total(sample, sampling->transfer_calls, sampling->period);
+}
+
+std::string format_estimate(double total, double margin) {
+  std::ostringstream oss;
+  oss << "~" << std::llround(total) << " (±" << std::llround(margin) << ")";
+  return oss.str();
+}
+
+/* Prints the potential resource savings extrapolated from the sampled
+ * transfers. Allocations and deletions are never sampled, so their figures are
+ * exact.
+ *
+ * A duplicate or round trip is only seen when both transfers of the pair were
+ * sampled, about 1 in period^2 pairs with random sampling, so extrapolating
+ * them by the period would still be biased low. Only unused and constant
+ * transfers, which are found from the transfer alone, are extrapolated. The
+ * sampled duplicates and round trips are added as they are, making the totals
+ * lower bounds.
+ */
+void print_sampled_resource_savings(
+    const std::set<const data_op_info_t *> &pot_unnecessary_ops,
+    const std::set<const data_op_info_t *> &pot_dd_ops,
+    const std::set<const data_op_info_t *> &pot_rt_ops,
+    const std::set<const data_op_info_t *> &pot_ut_ops,
+    const std::set<const data_op_info_t *> &pot_ct_ops, uint64_t pot_ad_calls,
+    uint64_t pot_ua_calls,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+    duration<uint64_t, std::nano> exec_time, const sampling_info_t *sampling) {
+  const estimate_t ut = estimate_calls(data_op_log_ptr, pot_ut_ops, sampling);
+  const estimate_t ct = estimate_calls(data_op_log_ptr, pot_ct_ops, sampling);
+
+  // sampled transfers as (x, y) pairs for calls, bytes and time, where y is x
+  // if the transfer is potentially unnecessary on its own and 0 otherwise
+  std::vector<std::pair<double, double>> calls_sample;
+  std::vector<std::pair<double, double>> bytes_sample;
+  std::vector<std::pair<double, double>> time_sample;
+  // sampled transfers only flagged as part of a duplicate or round trip
+  duration<uint64_t, std::nano> pot_pair_time(0);
+  uint64_t pot_pair_calls = 0;
+  uint64_t pot_pair_bytes = 0;
+  duration<uint64_t, std::nano> pot_alloc_time(0);
+  uint64_t pot_alloc_calls = 0;
+  uint64_t pot_alloc_bytes = 0;
+  for (const data_op_info_t &entry : *data_op_log_ptr) {
+    const bool flagged = pot_unnecessary_ops.count(&entry) != 0;
+    const duration<uint64_t, std::nano> entry_time =
+        entry.end_time - entry.start_time;
+    if (is_transfer_op(entry.optype)) {
+      const bool single =
+          pot_ut_ops.count(&entry) != 0 || pot_ct_ops.count(&entry) != 0;
+      calls_sample.emplace_back(1.0, single ? 1.0 : 0.0);
+      bytes_sample.emplace_back(entry.bytes, single ? entry.bytes : 0.0);
+      time_sample.emplace_back(entry_time.count(),
+                               single ? entry_time.count() : 0.0);
+      if (flagged && !single) {
+        pot_pair_calls += 1;
+        pot_pair_bytes += entry.bytes;
+        pot_pair_time += entry_time;
+      }
+    } else if (flagged) {
+      pot_alloc_time += entry_time;
+      if (is_alloc_op(entry.optype)) {
+        pot_alloc_calls += 1;
+        pot_alloc_bytes += entry.bytes;
+      }
+    }
+  }
+  const estimate_t calls = estimate_total(
+      calls_sample, sampling->transfer_calls, sampling->period);
+  const estimate_t bytes = estimate_total(
+      bytes_sample, sampling->transfer_bytes, sampling->period);
+  const estimate_t time = estimate_total(
+      time_sample, sampling->transfer_time.count(), sampling->period);
+  const double pot_time =
+      time.total + pot_pair_time.count() + pot_alloc_time.count();
+
+  std::cerr << "\n  Sampled " << std::dec << calls_sample.size() << " of "
+            << sampling->transfer_calls << " data transfer(s) ("
+            << (sampling->random ? "at random, " : "") << "1 in "
+            << sampling->period
+            << "). Estimates are given with 95% confidence intervals.\n";
+  std::cerr << "  Duplicates and round trips are only found when both "
+               "transfers were sampled,\n  their counts and savings are "
+               "lower bounds.\n";
+  std::cerr << "  Found at least " << std::dec << pot_dd_ops.size()
+            << " potential duplicate data transfer(s).\n";
+  std::cerr << "  Found at least " << std::dec << pot_rt_ops.size()
+            << " potential round trip data transfer(s).\n";
+  std::cerr << "  Found " << std::dec << pot_ad_calls
+            << " potential repeated device memory allocation(s).\n";
+  std::cerr << "  Found " << std::dec << pot_ua_calls
+            << " potential unused device memory allocation(s).\n";
+  std::cerr << "  Found " << format_estimate(ut.total, ut.margin)
+            << " potential unused data transfer(s).\n";
+  std::cerr << "  Found " << format_estimate(ct.total, ct.margin)
+            << " potential constant data transfer(s).\n";
+
+  std::cerr << "  Potential Resource Savings (lower bound)\n";
+  constexpr int w = std::max(f_w, f_w_bytes);
+  // clang-format off
+  std::cerr <<   "    time(%)           "
+            << format_percent(pot_time / exec_time.count(), w) << "  ±"
+            << format_percent(time.margin / exec_time.count(), f_w)
+            << "\n    time              "
+            << format_duration(std::llround(pot_time), w) << "  ±"
+            << format_duration(std::llround(time.margin), f_w)
+            << "\n    data transfers    "
+            << format_uint(std::llround(calls.total) + pot_pair_calls, w)
+            << "  ±"
+            << format_uint(std::llround(calls.margin), f_w)
+            << "\n    bytes transferred "
+            << format_uint(std::llround(bytes.total) + pot_pair_bytes, w)
+            << "  ±"
+            << format_uint(std::llround(bytes.margin), f_w)
+            << "\n    allocations       "
+            << format_uint(pot_alloc_calls, w)
+            << "\n    bytes allocated   "
+            << format_uint(pot_alloc_bytes, w)
+            << "\n";
+  // clang-format on
+  return;
+}
+
 void print_potential_resource_savings(
     const std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
                              std::vector<const data_op_info_t *>>>
@@ -571,10 +895,20 @@ void print_potential_resource_savings(
     const std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
                              std::vector<const data_op_info_t *>>>
         &unused_transfer_durations,
-    duration<uint64_t, std::nano> exec_time, int num_devices) {
+    const std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
+                             std::vector<const data_op_info_t *>>>
+        &constant_transfer_durations,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+    duration<uint64_t, std::nano> exec_time, const sampling_info_t *sampling) {
 
   // set of potentially unnecessary operations
   std::set<const data_op_info_t *> pot_unnecessary_ops;
+  // potentially unnecessary transfers of each kind, used to count or
+  // extrapolate the number of issues when transfers are sampled
+  std::set<const data_op_info_t *> pot_dd_ops;
+  std::set<const data_op_info_t *> pot_rt_ops;
+  std::set<const data_op_info_t *> pot_ut_ops;
+  std::set<const data_op_info_t *> pot_ct_ops;
 
   uint64_t pot_dd_calls = 0;
   for (auto it = duplicate_transfer_durations.rbegin();
@@ -584,6 +918,7 @@ void print_potential_resource_savings(
     pot_dd_calls += info_list.size() - 1;
     for (size_t i = 1; i < info_list.size(); ++i) {
       pot_unnecessary_ops.emplace(info_list[i]);
+      pot_dd_ops.emplace(info_list[i]);
     }
   }
 
@@ -604,6 +939,7 @@ void print_potential_resource_savings(
     pot_rt_calls += info_list.size();
     for (size_t i = 0; i < info_list.size(); ++i) {
       const data_op_info_t *tx_ptr = info_list[i].first;
+      pot_rt_ops.emplace(tx_ptr);
       if (i != 0 || is_transfer_from_op(tx_ptr->optype)) {
         pot_unnecessary_ops.emplace(tx_ptr);
       }
@@ -613,38 +949,9 @@ void print_potential_resource_savings(
   }
 
   uint64_t pot_ad_calls = 0;
-  for (auto it = repeated_alloc_durations.rbegin();
-       it != repeated_alloc_durations.rend(); ++it) {
-    // we assume the first allocation and last delete to be unavoidable
-    const std::vector<std::pair<const data_op_info_t *, const data_op_info_t *>>
-        &info_list = it->second;
-    pot_ad_calls += info_list.size() - 1;
-    for (size_t i = 0; i < info_list.size(); ++i) {
-      const data_op_info_t *alloc_ptr = info_list[i].first;
-      const data_op_info_t *delete_ptr = info_list[i].second;
-      if (i != 0) {
-        pot_unnecessary_ops.emplace(alloc_ptr);
-      }
-      if (i != info_list.size() - 1) {
-        pot_unnecessary_ops.emplace(delete_ptr);
-      }
-    }
-  }
-
   uint64_t pot_ua_calls = 0;
-  for (auto it = unused_alloc_durations.rbegin();
-       it != unused_alloc_durations.rend(); ++it) {
-    // we assume all unused allocations to be avoidable
-    const std::vector<std::pair<const data_op_info_t *, const data_op_info_t *>>
-        &info_list = it->second;
-    pot_ua_calls += info_list.size();
-    for (size_t i = 0; i < info_list.size(); ++i) {
-      const data_op_info_t *alloc_ptr = info_list[i].first;
-      const data_op_info_t *delete_ptr = info_list[i].second;
-      pot_unnecessary_ops.emplace(alloc_ptr);
-      pot_unnecessary_ops.emplace(delete_ptr);
-    }
-  }
+  get_pot_unnecessary_allocs(pot_unnecessary_ops, pot_ad_calls, pot_ua_calls,
+                             repeated_alloc_durations, unused_alloc_durations);
 
   uint64_t pot_ut_calls = 0;
   for (auto it = unused_transfer_durations.rbegin();
@@ -654,6 +961,19 @@ void print_potential_resource_savings(
     pot_ut_calls += info_list.size();
     for (size_t i = 0; i < info_list.size(); ++i) {
       pot_unnecessary_ops.emplace(info_list[i]);
+      pot_ut_ops.emplace(info_list[i]);
+    }
+  }
+
+  uint64_t pot_ct_calls = 0;
+  for (auto it = constant_transfer_durations.rbegin();
+       it != constant_transfer_durations.rend(); ++it) {
+    // we assume constant data can always be initialized on the device instead
+    const std::vector<const data_op_info_t *> &info_list = it->second;
+    pot_ct_calls += info_list.size();
+    for (const data_op_info_t *info_ptr : info_list) {
+      pot_unnecessary_ops.emplace(info_ptr);
+      pot_ct_ops.emplace(info_ptr);
     }
   }
 
@@ -679,6 +999,14 @@ void print_potential_resource_savings(
     }
   }
 
+  if (sampling != nullptr) {
+    print_sampled_resource_savings(pot_unnecessary_ops, pot_dd_ops, pot_rt_ops,
+                                   pot_ut_ops, pot_ct_ops, pot_ad_calls,
+                                   pot_ua_calls, data_op_log_ptr, exec_time,
+                                   sampling);
+    return;
+  }
+
   std::cerr << "\n  Found " << std::dec << pot_dd_calls
             << " potential duplicate data transfer(s) with "
             << duplicate_transfer_durations.size() << " unique hash(es).\n";
@@ -690,6 +1018,8 @@ void print_potential_resource_savings(
             << " potential unused device memory allocation(s).\n";
   std::cerr << "  Found " << std::dec << pot_ut_calls
             << " potential unused data transfer(s).\n";
+  std::cerr << "  Found " << std::dec << pot_ct_calls
+            << " potential constant data transfer(s).\n";
 
   std::cerr << "  Potential Resource Savings\n";
   constexpr int w = std::max(f_w, f_w_bytes);
@@ -740,17 +1070,20 @@ void analyze_duplicate_transfers(
     std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
                        std::vector<const data_op_info_t *>>>
         &duplicate_transfer_durations,
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     duration<uint64_t, std::nano> exec_time, int num_devices) {
   duplicate_transfer_durations.clear();
-  std::map<std::pair<HASH_T, int /*dest_device_num*/>,
+  // transfers are compared by size too, which makes the comparison of inline
+  // payloads exact
+  std::map<std::tuple<HASH_T, size_t /*bytes*/, int /*dest_device_num*/>,
            std::vector<const data_op_info_t *>>
       received;
   for (const data_op_info_t &entry : *data_op_log_ptr) {
     if (!is_transfer_op(entry.optype)) {
       continue;
     }
-    const std::pair<HASH_T, int> key(entry.hash, entry.dest_device_num);
+    const std::tuple<HASH_T, size_t, int> key(entry.hash, entry.bytes,
+                                              entry.dest_device_num);
     received[key].push_back(&entry);
   }
 
@@ -778,25 +1111,27 @@ void analyze_round_trip_transfers(
         duration<uint64_t, std::nano> /*total_time*/,
         std::vector<std::pair<const data_op_info_t *, const data_op_info_t *>>>>
         &round_trip_durations,
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     duration<uint64_t, std::nano> exec_time, int num_devices) {
   round_trip_durations.clear();
-  std::map<std::pair<HASH_T, int /*dest_device_num*/>,
+  std::map<std::tuple<HASH_T, size_t /*bytes*/, int /*dest_device_num*/>,
            std::deque<const data_op_info_t *>>
       received;
   for (const data_op_info_t &entry : *data_op_log_ptr) {
     if (!is_transfer_op(entry.optype)) {
       continue;
     }
-    const std::pair<HASH_T, int> key(entry.hash, entry.dest_device_num);
+    const std::tuple<HASH_T, size_t, int> key(entry.hash, entry.bytes,
+                                              entry.dest_device_num);
     received[key].push_back(&entry);
   }
 
   // _Round Trip Transfers_ are when data is transferred then the same data is
   // transferred back (unmodified).
-  std::map<
-      std::tuple<HASH_T, int /*src_device_num*/, int /*dest_device_num*/>,
-      std::vector<std::pair<const data_op_info_t *, const data_op_info_t *>>>
+  std::map<std::tuple<HASH_T, size_t /*bytes*/, int /*src_device_num*/,
+                      int /*dest_device_num*/>,
+           std::vector<
+               std::pair<const data_op_info_t *, const data_op_info_t *>>>
       round_trip_transfers;
   for (const data_op_info_t &tx_entry : *data_op_log_ptr) {
     if (!is_transfer_op(tx_entry.optype)) {
@@ -805,20 +1140,22 @@ void analyze_round_trip_transfers(
 
     // Check if this data is later received by this device. If so, this is a
     // candidate for a round trip transfer.
-    const std::pair<HASH_T, int> rx_key(tx_entry.hash, tx_entry.src_device_num);
+    const std::tuple<HASH_T, size_t, int> rx_key(
+        tx_entry.hash, tx_entry.bytes, tx_entry.src_device_num);
     const auto &rx_it = received.find(rx_key);
     if (rx_it == received.end() || rx_it->second.empty()) {
       // the round-trip is never completed, the data is never sent back
       continue;
     }
-    const std::tuple<HASH_T, int, int> trip_key(
-        tx_entry.hash, tx_entry.src_device_num, tx_entry.dest_device_num);
+    const std::tuple<HASH_T, size_t, int, int> trip_key(
+        tx_entry.hash, tx_entry.bytes, tx_entry.src_device_num,
+        tx_entry.dest_device_num);
     const data_op_info_t *rx_entry = rx_it->second.front();
     const std::pair<const data_op_info_t *, const data_op_info_t *> tx_rx(
         &tx_entry, rx_entry);
     round_trip_transfers[trip_key].emplace_back(tx_rx);
-    const std::pair<HASH_T, int> tx_key(tx_entry.hash,
-                                        tx_entry.dest_device_num);
+    const std::tuple<HASH_T, size_t, int> tx_key(
+        tx_entry.hash, tx_entry.bytes, tx_entry.dest_device_num);
     const auto &tx_it = received.find(tx_key);
 #ifdef DEBUG
     const data_op_info_t *_tx_entry = tx_it->second.front();
@@ -852,7 +1189,7 @@ void get_allocation_pairs(
     std::vector<std::pair<const data_op_info_t * /*alloc*/,
                           const data_op_info_t * /*delete*/>> &alloc_log,
     std::vector<uint64_t> &peak_allocated_bytes,
-    const std::vector<data_op_info_t> *data_op_log_ptr, int num_devices) {
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr, int num_devices) {
   alloc_log.clear();
   peak_allocated_bytes = std::vector<uint64_t>(num_devices, 0);
   std::vector<uint64_t> num_allocated_bytes(num_devices, 0);
@@ -948,7 +1285,7 @@ void analyze_repeated_allocs(
 
 void get_device_target_log(
     std::vector<std::vector<const target_info_t *>> &device_target_log,
-    const std::vector<target_info_t> *target_log_ptr, int num_devices) {
+    const std::pmr::vector<target_info_t> *target_log_ptr, int num_devices) {
   device_target_log =
       std::vector<std::vector<const target_info_t *>>(num_devices);
   for (const target_info_t &entry : *target_log_ptr) {
@@ -977,7 +1314,7 @@ void get_device_alloc_log(
 void get_device_transfer_log(
     std::vector<std::vector<const data_op_info_t * /*transfer*/>>
         &device_transfer_log,
-    const std::vector<data_op_info_t> *data_op_log_ptr, int num_devices) {
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr, int num_devices) {
   device_transfer_log =
       std::vector<std::vector<const data_op_info_t * /*transfer*/>>(
           num_devices);
@@ -989,6 +1326,17 @@ void get_device_transfer_log(
   return;
 }
 
+bool target_started_between(
+    const std::vector<const target_info_t *> &target_log,
+    steady_clock::time_point begin, steady_clock::time_point end) {
+  const auto it = std::upper_bound(
+      target_log.begin(), target_log.end(), begin,
+      [](steady_clock::time_point time, const target_info_t *entry) {
+        return time < entry->start_time;
+      });
+  return it != target_log.end() && (*it)->start_time <= end;
+}
+
 void analyze_unused_allocs(
     Symbolizer &symbolizer,
     std::set<
@@ -1014,18 +1362,15 @@ void analyze_unused_allocs(
   for (int device_idx = 0; device_idx < num_devices; ++device_idx) {
     const auto &_target_log = device_target_log[device_idx];
     const auto &_alloc_log = device_alloc_log[device_idx];
-    size_t tgt_idx = 0;
     for (size_t a_idx = 0; a_idx < _alloc_log.size(); ++a_idx) {
       const data_op_info_t *a = _alloc_log[a_idx].first;
       const data_op_info_t *d = _alloc_log[a_idx].second;
-      // find the first target_log[tgt_idx] that might overlap with
-      // alloc_log[a_idx]
-      while (tgt_idx < _target_log.size() &&
-             _target_log[tgt_idx]->end_time < a->start_time) {
-        ++tgt_idx;
+      // data mapped by a target construct is used by the construct's kernel
+      if (a->target_id != 0 || d->target_id != 0) {
+        continue;
       }
-      if (tgt_idx == _target_log.size() ||
-          _target_log[tgt_idx]->start_time > d->end_time) {
+      // otherwise the data must be mapped when a target region starts
+      if (!target_started_between(_target_log, a->start_time, d->end_time)) {
         std::tuple<void *, int, size_t> key(a->src_addr, a->dest_device_num,
                                             a->bytes);
         unused_allocs[key].emplace_back(a, d);
@@ -1067,37 +1412,35 @@ void analyze_unused_transfers(
   for (int device_idx = 0; device_idx < num_devices; ++device_idx) {
     const auto &_target_log = device_target_log[device_idx];
     const auto &_transfer_log = device_transfer_log[device_idx];
-    size_t tgt_idx = 0;
+    // latest transfer of each host buffer issued outside of a target region
     std::map<void * /*host_addr*/, const data_op_info_t *> candidates;
     for (size_t t_idx = 0; t_idx < _transfer_log.size(); ++t_idx) {
       const data_op_info_t *t = _transfer_log[t_idx];
-      // find the first target_log[tgt_idx] that might overlap with
-      // transfer_log[t_idx]
-      while (tgt_idx < _target_log.size() &&
-             _target_log[tgt_idx]->end_time < t->start_time) {
-        ++tgt_idx;
-        candidates.clear();
-      }
-      if (tgt_idx == _target_log.size()) {
-        // transfers to a device, but the device will never be active again.
-        std::tuple<void *, int, size_t> key(t->src_addr, t->dest_device_num,
-                                            t->bytes);
-        unused_transfers[key].emplace_back(t);
-      } else if (_target_log[tgt_idx]->start_time > t->start_time) {
-        // transfer doesn't overlap with a target region, may be a candidate
-        const auto it = candidates.find(t->src_addr);
-        if (it != candidates.end()) {
-          // commit the previous candidate, this transfer is now the candidate
-          const data_op_info_t *cand = it->second;
+      const auto it = candidates.find(t->src_addr);
+      if (it != candidates.end()) {
+        // the candidate is overwritten before any target region could read it
+        const data_op_info_t *cand = it->second;
+        if (!target_started_between(_target_log, cand->start_time,
+                                    t->start_time)) {
           std::tuple<void *, int, size_t> key(
               cand->src_addr, cand->dest_device_num, cand->bytes);
           unused_transfers[key].emplace_back(cand);
-          it->second = t;
-        } else {
-          candidates[t->src_addr] = t;
         }
-      } else {
-        candidates.clear();
+        candidates.erase(it);
+      }
+      // data transferred by a target construct is read by the construct's
+      // kernel
+      if (t->target_id == 0) {
+        candidates.emplace(t->src_addr, t);
+      }
+    }
+    for (const auto &[host_addr, cand] : candidates) {
+      if (!target_started_between(_target_log, cand->start_time,
+                                  steady_clock::time_point::max())) {
+        // transfers to a device, but the device will never be active again.
+        std::tuple<void *, int, size_t> key(
+            cand->src_addr, cand->dest_device_num, cand->bytes);
+        unused_transfers[key].emplace_back(cand);
       }
     }
   }
@@ -1115,10 +1458,57 @@ void analyze_unused_transfers(
   return;
 }
 
-void analyze_inefficient_transfers(
-    Symbolizer &symbolizer, const std::vector<target_info_t> *target_log_ptr,
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+/* Finds the transfers to a device of constant data (see
+ * find_constant_pattern()), which could be initialized on the device instead.
+ */
+void analyze_constant_transfers(
+    Symbolizer &symbolizer,
+    std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
+                       std::vector<const data_op_info_t *>>>
+        &constant_transfer_durations,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     duration<uint64_t, std::nano> exec_time, int num_devices) {
+  constant_transfer_durations.clear();
+
+  std::map<std::tuple<const void * /*codeptr_ra*/, int /*dest_device_num*/,
+                      uint64_t /*pattern*/>,
+           std::vector<const data_op_info_t *>>
+      constant_transfers;
+  for (const data_op_info_t &entry : *data_op_log_ptr) {
+    if (!is_transfer_to_op(entry.optype) ||
+        !is_constant_fingerprint(entry.hash, entry.bytes)) {
+      continue;
+    }
+    const std::tuple<const void *, int, uint64_t> key(
+        entry.codeptr_ra, entry.dest_device_num, entry.hash.low64);
+    constant_transfers[key].push_back(&entry);
+  }
+
+  for (const auto &entry : constant_transfers) {
+    duration<uint64_t, std::nano> duration(0);
+    for (const data_op_info_t *transfer_ptr : entry.second) {
+      duration += transfer_ptr->end_time - transfer_ptr->start_time;
+    }
+    constant_transfer_durations.emplace(duration, entry.second);
+  }
+
+  print_constant_transfers(symbolizer, constant_transfer_durations, exec_time,
+                           num_devices);
+  return;
+}
+
+void analyze_inefficient_transfers(
+    Symbolizer &symbolizer,
+    const std::pmr::vector<target_info_t> *target_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+    duration<uint64_t, std::nano> exec_time, int num_devices,
+    const sampling_info_t *sampling) {
+
+  if (sampling != nullptr) {
+    std::cerr << "\nnote: about 1 in " << sampling->period
+              << " data transfers was sampled, the analyses below only list "
+                 "sampled transfers.\n";
+  }
 
   std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
                      std::vector<const data_op_info_t *>>>
@@ -1172,20 +1562,259 @@ void analyze_inefficient_transfers(
                            device_target_log, device_transfer_log, exec_time,
                            num_devices);
 
+  std::set<std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
+                     std::vector<const data_op_info_t *>>>
+      constant_transfer_durations;
+  analyze_constant_transfers(symbolizer, constant_transfer_durations,
+                             data_op_log_ptr, exec_time, num_devices);
+
   print_potential_resource_savings(
       duplicate_transfer_durations, round_trip_durations,
       repeated_alloc_durations, unused_alloc_durations,
-      unused_transfer_durations, exec_time, num_devices);
+      unused_transfer_durations, constant_transfer_durations, data_op_log_ptr,
+      exec_time, sampling);
 
   print_peak_device_memory_allocation(peak_allocated_bytes);
   return;
 }
 
+void print_stream_duplicates(Symbolizer &symbolizer,
+                             const stream_results_t &results,
+                             duration<uint64_t, std::nano> exec_time,
+                             int num_devices) {
+  std::cerr << "\n=== OpenMP Duplicate Target Data Transfer Analysis ===\n";
+  if (results.duplicates.empty()) {
+    std::cerr << "  SUCCESS - no duplicate data transfers detected\n";
+    return;
+  }
+  // clang-format off
+  std::cerr << std::setw(f_w) << "time(%)"
+            << std::setw(f_w) << "time"
+            << std::setw(f_w) << "calls"
+            << std::setw(f_w) << "avg"
+            << std::setw(f_w_bytes) << "bytes"
+            << std::setw(f_w) << "size"
+            << std::left << std::setw(f_w_device_id) << "  dest device"
+            << std::right << "   "
+            << std::setw(f_w) << "calls"
+            << std::left << std::setw(f_w_device_id) << "  src device"
+            << std::right << "  location\n";
+  // clang-format on
+
+  std::vector<const stream_duplicate_t *> duplicates;
+  for (const stream_duplicate_t &dup : results.duplicates) {
+    duplicates.push_back(&dup);
+  }
+  std::sort(duplicates.begin(), duplicates.end(),
+            [](const stream_duplicate_t *a, const stream_duplicate_t *b) {
+              return a->time > b->time;
+            });
+
+  for (size_t idx = 0; idx < duplicates.size() && idx < f_list_len; ++idx) {
+    const stream_duplicate_t &dup = *duplicates[idx];
+    const float time_percent = dup.time.count() / (float)exec_time.count();
+    const duration<uint64_t, std::nano> time_avg(
+        (uint64_t)std::roundf(dup.time.count() / (float)dup.calls));
+    assert(!dup.sources.empty());
+    for (size_t subidx = 0;
+         subidx < dup.sources.size() && subidx < f_sublist_len; ++subidx) {
+      const auto [sub_calls, src_device_num, codeptr_ra] = dup.sources[subidx];
+      if (subidx == 0) {
+        // clang-format off
+        std::cerr << format_percent(time_percent, f_w)
+                  << format_duration(dup.time.count(), f_w)
+                  << format_uint(dup.calls, f_w)
+                  << format_duration(time_avg.count(), f_w)
+                  << format_uint(dup.calls * dup.size, f_w_bytes)
+                  << format_uint(dup.size, f_w)
+                  << format_device_num(num_devices, dup.dest_device_num,
+                                       f_w_device_id);
+        // clang-format on
+        std::cerr << (dup.sources.size() > 1 ? " ┬─" : " ──");
+      } else {
+        std::cerr << std::string(5 * f_w + f_w_bytes + f_w_device_id, ' ');
+        std::cerr << (dup.sources.size() > subidx + 1 ? " ├─" : " └─");
+      }
+      // clang-format off
+      std::cerr << format_uint(sub_calls, f_w)
+                << format_device_num(num_devices, src_device_num,
+                                     f_w_device_id)
+                << format_symbol(symbolizer, codeptr_ra)
+                << "\n";
+      // clang-format on
+    }
+  }
+  return;
+}
+
+void print_stream_round_trips(Symbolizer &symbolizer,
+                              const stream_results_t &results,
+                              duration<uint64_t, std::nano> exec_time,
+                              int num_devices) {
+  std::cerr << "\n=== OpenMP Round-Trip Target Data Transfer Analysis ===\n";
+  if (results.round_trips.empty()) {
+    std::cerr << "  SUCCESS - no round-trip data transfers detected\n";
+    return;
+  }
+  // clang-format off
+  std::cerr << std::setw(f_w) << "time(%)"
+            << std::setw(f_w) << "time"
+            << std::setw(f_w) << "trips"
+            << std::setw(f_w) << "avg"
+            << std::setw(f_w_bytes) << "bytes"
+            << std::setw(f_w) << "size"
+            << "   "
+            << std::left << std::setw(f_w_device_id) << "  src device"
+            << std::setw(f_w_device_id) << "  dest device"
+            << std::setw(f_w_optype) << "  optype"
+            << std::right << "  location\n";
+  // clang-format on
+
+  std::vector<const stream_round_trip_t *> round_trips;
+  for (const stream_round_trip_t &trip : results.round_trips) {
+    round_trips.push_back(&trip);
+  }
+  std::sort(round_trips.begin(), round_trips.end(),
+            [](const stream_round_trip_t *a, const stream_round_trip_t *b) {
+              return a->time > b->time;
+            });
+
+  for (size_t idx = 0; idx < round_trips.size() && idx < f_list_len; ++idx) {
+    const stream_round_trip_t &trip = *round_trips[idx];
+    const float time_percent = trip.time.count() / (float)exec_time.count();
+    const duration<uint64_t, std::nano> time_avg(
+        (uint64_t)std::roundf(trip.time.count() / (float)trip.trips));
+    // clang-format off
+    std::cerr << format_percent(time_percent, f_w)
+              << format_duration(trip.time.count(), f_w)
+              << format_uint(trip.trips, f_w)
+              << format_duration(time_avg.count(), f_w)
+              << format_uint(2 * trip.trips * trip.size, f_w_bytes)
+              << format_uint(trip.size, f_w)
+              << " ┬─"
+              << format_device_num(num_devices, trip.src_device_num,
+                                   f_w_device_id)
+              << format_device_num(num_devices, trip.dest_device_num,
+                                   f_w_device_id)
+              << format_optype(trip.tx_optype, f_w_optype)
+              << format_symbol(symbolizer, trip.tx_codeptr_ra)
+              << "\n";
+    std::cerr << std::string(5 * f_w + f_w_bytes, ' ')
+              << " └─"
+              << format_device_num(num_devices, trip.dest_device_num,
+                                   f_w_device_id)
+              << format_device_num(num_devices, trip.src_device_num,
+                                   f_w_device_id)
+              << format_optype(trip.rx_optype, f_w_optype)
+              << format_symbol(symbolizer, trip.rx_codeptr_ra)
+              << "\n";
+    // clang-format on
+  }
+  return;
+}
+
+void analyze_stream_transfers(Symbolizer &symbolizer,
+                              const stream_results_t &results,
+                              duration<uint64_t, std::nano> exec_time,
+                              int num_devices) {
+  // online mode keeps no event log at all, allocations and deletions only
+  // show up in the statistics of their call site
+  if (results.evictions > 0) {
+    std::cerr << "\nnote: " << results.evictions
+              << " entries were evicted from the online transfer index, "
+                 "duplicate and round-trip counts are lower bounds.\n";
+  }
+  print_stream_duplicates(symbolizer, results, exec_time, num_devices);
+  print_stream_round_trips(symbolizer, results, exec_time, num_devices);
+
+  std::cerr << "\n=== OpenMP Repeated Target Device Allocation Analysis ===\n";
+  std::cerr << "  SKIPPED - not available in online mode\n";
+  std::cerr << "\n=== OpenMP Unused Target Device Allocation Analysis ===\n";
+  std::cerr << "  SKIPPED - not available in online mode\n";
+  std::cerr << "\n=== OpenMP Unused Target Data Transfer Analysis ===\n";
+  std::cerr << "  SKIPPED - not available in online mode\n";
+
+  std::cerr << "\n  Found " << std::dec << results.pot_dd_calls
+            << " potential duplicate data transfer(s) with "
+            << results.pot_dd_hashes << " unique hash(es).\n";
+  std::cerr << "  Found " << std::dec << results.pot_rt_calls
+            << " potential round trip data transfer(s).\n";
+
+  std::cerr << "  Potential Resource Savings\n";
+  constexpr int w = std::max(f_w, f_w_bytes);
+  const duration<uint64_t, std::nano> pot_time = results.pot_trans_time;
+  // clang-format off
+  std::cerr <<   "    time(%)           "
+            << format_percent(pot_time.count() / (float)exec_time.count(), w)
+            << "\n    time              "
+            << format_duration(pot_time.count(), w)
+            << "\n    data transfers    "
+            << format_uint(results.pot_trans_calls, w)
+            << "\n    bytes transferred "
+            << format_uint(results.pot_trans_bytes, w)
+            << "\n";
+  // clang-format on
+  return;
+}
+
+void get_data_op_site_stats(
+    std::vector<data_op_site_stats_t> &site_stats,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr) {
+  site_stats.clear();
+  std::map<
+      std::pair<const void * /*codeptr_ra*/, ompt_target_data_op_t /*optype*/>,
+      data_op_site_stats_t>
+      codeptr_to_stats;
+  for (const data_op_info_t &entry : *data_op_log_ptr) {
+    const std::pair<const void *, ompt_target_data_op_t> key(entry.codeptr_ra,
+                                                             entry.optype);
+    const duration<uint64_t, std::nano> entry_duration =
+        entry.end_time - entry.start_time;
+    data_op_site_stats_t &stats = codeptr_to_stats[key];
+    if (stats.calls == 0) {
+      stats.codeptr_ra = entry.codeptr_ra;
+      stats.optype = entry.optype;
+      stats.min_time = entry_duration;
+      stats.max_time = entry_duration;
+    }
+    stats.calls += 1;
+    stats.bytes += entry.bytes;
+    stats.time += entry_duration;
+    stats.min_time = std::min(stats.min_time, entry_duration);
+    stats.max_time = std::max(stats.max_time, entry_duration);
+  }
+
+  site_stats.reserve(codeptr_to_stats.size());
+  for (const auto &entry : codeptr_to_stats) {
+    site_stats.push_back(entry.second);
+  }
+  return;
+}
+
+void get_sampling_info(
+    sampling_info_t &sampling,
+    const std::vector<data_op_site_stats_t> *site_stats_ptr, uint64_t period,
+    bool random) {
+  sampling.period = period;
+  sampling.random = random;
+  sampling.transfer_calls = 0;
+  sampling.transfer_bytes = 0;
+  sampling.transfer_time = duration<uint64_t, std::nano>(0);
+  for (const data_op_site_stats_t &stats : *site_stats_ptr) {
+    if (!is_transfer_op(stats.optype)) {
+      continue;
+    }
+    sampling.transfer_calls += stats.calls;
+    sampling.transfer_bytes += stats.bytes;
+    sampling.transfer_time += stats.time;
+  }
+  return;
+}
+
 void print_codeptr_durations(
     Symbolizer &symbolizer,
     const std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
-                             std::vector<const data_op_info_t *>>>
-        &codeptr_durations,
+                             const data_op_site_stats_t *>> &codeptr_durations,
     duration<uint64_t, std::nano> exec_time) {
 
   size_t idx = 0;
@@ -1212,38 +1841,22 @@ void print_codeptr_durations(
       break;
     }
     const duration<uint64_t, std::nano> time = it->first;
-    const std::vector<const data_op_info_t *> &info_list = it->second;
+    const data_op_site_stats_t *stats = it->second;
     const float time_percent = time.count() / (float)exec_time.count();
-    const uint64_t calls = info_list.size();
+    const uint64_t calls = stats->calls;
     const duration<uint64_t, std::nano> time_avg(
         (uint64_t)std::roundf(time.count() / (float)calls));
-    duration<uint64_t, std::nano> time_min(UINT64_MAX);
-    duration<uint64_t, std::nano> time_max(0);
-    uint64_t bytes = 0;
-    assert(!info_list.empty());
-    const ompt_target_data_op_t optype = info_list[0]->optype;
-    const void *codeptr_ra = info_list[0]->codeptr_ra;
-    for (const data_op_info_t *entry_ptr : info_list) {
-      const duration<uint64_t, std::nano> entry_duration =
-          (entry_ptr->end_time - entry_ptr->start_time);
-      if (entry_duration < time_min) {
-        time_min = entry_duration;
-      }
-      if (entry_duration > time_max) {
-        time_max = entry_duration;
-      }
-      bytes += entry_ptr->bytes;
-    }
+    assert(calls > 0);
     // clang-format off
     std::cerr << format_percent(time_percent, f_w)
               << format_duration(time.count(), f_w)
               << format_uint(calls, f_w)
               << format_duration(time_avg.count(), f_w)
-              << format_duration(time_min.count(), f_w)
-              << format_duration(time_max.count(), f_w)
-              << format_uint(bytes, f_w_bytes)
-              << format_optype(optype, f_w_optype)
-              << format_symbol(symbolizer, codeptr_ra)
+              << format_duration(stats->min_time.count(), f_w)
+              << format_duration(stats->max_time.count(), f_w)
+              << format_uint(stats->bytes, f_w_bytes)
+              << format_optype(stats->optype, f_w_optype)
+              << format_symbol(symbolizer, stats->codeptr_ra)
               << "\n";
     // clang-format on
     ++idx;
@@ -1253,46 +1866,201 @@ void print_codeptr_durations(
 }
 
 void analyze_codeptr_durations(
-    Symbolizer &symbolizer, const std::vector<data_op_info_t> *data_op_log_ptr,
+    Symbolizer &symbolizer,
+    const std::vector<data_op_site_stats_t> *site_stats_ptr,
     duration<uint64_t, std::nano> exec_time) {
   // for identifying most expensive code
-  std::map<
-      std::pair<const void * /*codeptr_ra*/, ompt_target_data_op_t /*optype*/>,
-      std::vector<const data_op_info_t *>>
-      codeptr_to_data_op;
   std::set<std::pair<duration<uint64_t, std::nano> /*total_time*/,
-                     std::vector<const data_op_info_t *>>>
+                     const data_op_site_stats_t *>>
       codeptr_durations;
+  for (const data_op_site_stats_t &stats : *site_stats_ptr) {
+    codeptr_durations.emplace(stats.time, &stats);
+  }
+
+  print_codeptr_durations(symbolizer, codeptr_durations, exec_time);
+  return;
+}
+
+void print_region_stats(Symbolizer &symbolizer,
+                        const std::vector<region_stats_t> &region_stats,
+                        duration<uint64_t, std::nano> exec_time) {
+  std::cerr << "\n=== OpenMP Target Region Data/Compute Analysis ===\n";
+  if (region_stats.empty()) {
+    std::cerr << "  no target regions profiled\n";
+    return;
+  }
+  // clang-format off
+  std::cerr << std::setw(f_w) << "time(%)"
+            << std::setw(f_w) << "xfer time"
+            << std::setw(f_w) << "xfers"
+            << std::setw(f_w_bytes) << "bytes"
+            << std::setw(f_w) << "krnl time"
+            << std::setw(f_w) << "kernels"
+            << std::setw(f_w) << "ratio"
+            << "  location\n";
+  // clang-format on
+  bool any_approximate = false;
+  for (size_t idx = 0; idx < region_stats.size() && idx < f_list_len; ++idx) {
+    const region_stats_t &stats = region_stats[idx];
+    const float time_percent =
+        stats.transfer_time.count() / (float)exec_time.count();
+    // clang-format off
+    std::cerr << format_percent(time_percent, f_w)
+              << format_duration(stats.transfer_time.count(), f_w)
+              << format_uint(stats.transfer_calls, f_w)
+              << format_uint(stats.transfer_bytes, f_w_bytes)
+              << format_duration(stats.kernel_time.count(), f_w)
+              << format_uint(stats.kernels, f_w);
+    // clang-format on
+    if (stats.kernel_time.count() > 0) {
+      const bool approximate = stats.traced_kernels < stats.kernels;
+      any_approximate = any_approximate || approximate;
+      std::cerr << format_float(stats.transfer_time.count() /
+                                    (float)stats.kernel_time.count(),
+                                f_w, 0.01, approximate ? "*" : " ");
+    } else {
+      std::cerr << std::setw(f_w) << "- ";
+    }
+    std::cerr << format_symbol(symbolizer, stats.codeptr_ra) << "\n";
+  }
+  std::cerr << "  ratio is transfer time over kernel time, regions above 1 "
+               "spend more time moving data\n  than computing.\n";
+  if (any_approximate) {
+    std::cerr << "  * approximate, some kernels were not traced on their "
+                 "device and their kernel time\n  spans the submit begin "
+                 "and end events, which depending on the runtime cover\n  "
+                 "the kernel launch alone or its whole execution.\n";
+  }
+  return;
+}
 
+void analyze_regions(Symbolizer &symbolizer,
+                     const std::vector<data_op_site_stats_t> *site_stats_ptr,
+                     const std::pmr::vector<target_info_t> *target_log_ptr,
+                     const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                     const std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                     duration<uint64_t, std::nano> exec_time) {
+  std::unordered_map<uint64_t /*target_id*/, const void * /*codeptr_ra*/>
+      target_sites;
+  for (const target_info_t &entry : *target_log_ptr) {
+    target_sites.emplace(entry.target_id, entry.codeptr_ra);
+  }
+  // transfers and kernels of a target construct carry its target_id and are
+  // attributed to the call site of the construct, transfers of target data,
+  // target enter/exit data and target update constructs to their own
+  std::map<const void *, std::map<const void *, region_stats_t>> logged;
   for (const data_op_info_t &entry : *data_op_log_ptr) {
-    const std::pair<const void *, ompt_target_data_op_t> key(entry.codeptr_ra,
-                                                             entry.optype);
-    codeptr_to_data_op[key].push_back(&entry);
+    if (!is_transfer_op(entry.optype)) {
+      continue;
+    }
+    const auto it = entry.target_id != 0 ? target_sites.find(entry.target_id)
+                                         : target_sites.end();
+    const void *codeptr_ra =
+        it != target_sites.end() ? it->second : entry.codeptr_ra;
+    region_stats_t &region = logged[entry.codeptr_ra][codeptr_ra];
+    region.transfer_calls += 1;
+    region.transfer_bytes += entry.bytes;
+    region.transfer_time += entry.end_time - entry.start_time;
   }
-  for (auto &entry : codeptr_to_data_op) {
-    const std::vector<const data_op_info_t *> &info_list = entry.second;
-    duration<uint64_t, std::nano> duration(0);
-    assert(!info_list.empty());
-    for (const data_op_info_t *info_ptr : info_list) {
-      duration += info_ptr->end_time - info_ptr->start_time;
+  // the log may only hold a sample of the transfers, so the exact totals of
+  // each data op call site are split between its regions in the proportions
+  // of its logged transfers
+  std::map<const void *, region_stats_t> site_totals;
+  for (const data_op_site_stats_t &stats : *site_stats_ptr) {
+    if (!is_transfer_op(stats.optype)) {
+      continue;
+    }
+    region_stats_t &totals = site_totals[stats.codeptr_ra];
+    totals.transfer_calls += stats.calls;
+    totals.transfer_bytes += stats.bytes;
+    totals.transfer_time += stats.time;
+  }
+  std::map<const void *, region_stats_t> regions;
+  for (const auto &[site, totals] : site_totals) {
+    const auto it = logged.find(site);
+    if (it == logged.end()) {
+      region_stats_t &region = regions[site];
+      region.transfer_calls += totals.transfer_calls;
+      region.transfer_bytes += totals.transfer_bytes;
+      region.transfer_time += totals.transfer_time;
+      continue;
+    }
+    region_stats_t sample = {};
+    for (const auto &[codeptr_ra, part] : it->second) {
+      sample.transfer_calls += part.transfer_calls;
+      sample.transfer_bytes += part.transfer_bytes;
+      sample.transfer_time += part.transfer_time;
+    }
+    for (const auto &[codeptr_ra, part] : it->second) {
+      // share of 'total' in proportion to 'x' out of 'sum', by calls if
+      // nothing was measured
+      const auto share = [&](uint64_t total, uint64_t x, uint64_t sum) {
+        const double fraction =
+            sum > 0 ? x / (double)sum
+                    : part.transfer_calls / (double)sample.transfer_calls;
+        return (uint64_t)std::llround(total * fraction);
+      };
+      region_stats_t &region = regions[codeptr_ra];
+      region.transfer_calls += share(totals.transfer_calls,
+                                     part.transfer_calls,
+                                     sample.transfer_calls);
+      region.transfer_bytes += share(totals.transfer_bytes,
+                                     part.transfer_bytes,
+                                     sample.transfer_bytes);
+      region.transfer_time += duration<uint64_t, std::nano>(
+          share(totals.transfer_time.count(), part.transfer_time.count(),
+                sample.transfer_time.count()));
+    }
+  }
+  for (const kernel_info_t &entry : *kernel_log_ptr) {
+    const auto it = target_sites.find(entry.target_id);
+    const void *codeptr_ra = it != target_sites.end() ? it->second : nullptr;
+    region_stats_t &region = regions[codeptr_ra];
+    region.kernels += 1;
+    if (entry.exec_time.count() > 0) {
+      region.traced_kernels += 1;
+      region.kernel_time += entry.exec_time;
+    } else {
+      region.kernel_time += entry.end_time - entry.start_time;
     }
-    codeptr_durations.emplace(duration, info_list);
   }
 
-  print_codeptr_durations(symbolizer, codeptr_durations, exec_time);
+  std::vector<region_stats_t> region_stats;
+  region_stats.reserve(regions.size());
+  for (const auto &[codeptr_ra, stats] : regions) {
+    region_stats.push_back(stats);
+    region_stats.back().codeptr_ra = codeptr_ra;
+  }
+  // most bound by data movement first, i.e. highest transfer time over
+  // kernel time, then the regions without kernels by transfer time
+  std::sort(region_stats.begin(), region_stats.end(),
+            [](const region_stats_t &a, const region_stats_t &b) {
+              const bool a_kernels = a.kernel_time.count() > 0;
+              const bool b_kernels = b.kernel_time.count() > 0;
+              if (a_kernels != b_kernels) {
+                return a_kernels;
+              }
+              if (!a_kernels) {
+                return a.transfer_time > b.transfer_time;
+              }
+              // a.transfer / a.kernel > b.transfer / b.kernel
+              return a.transfer_time.count() * (double)b.kernel_time.count() >
+                     b.transfer_time.count() * (double)a.kernel_time.count();
+            });
+  print_region_stats(symbolizer, region_stats, exec_time);
   return;
 }
 
-void print_summary(const std::vector<data_op_info_t> *data_op_log_ptr,
+void print_summary(const std::vector<data_op_site_stats_t> *site_stats_ptr,
                    duration<uint64_t, std::nano> exec_time) {
   std::map<ompt_target_data_op_t, duration<uint64_t, std::nano>> op_time_map;
   std::map<ompt_target_data_op_t, uint64_t> op_bytes_map;
   std::map<ompt_target_data_op_t, uint64_t> op_calls_map;
-  for (const data_op_info_t &entry : *data_op_log_ptr) {
-    const ompt_target_data_op_t optype = entry.optype;
-    op_time_map[optype] += entry.end_time - entry.start_time;
-    op_bytes_map[optype] += entry.bytes;
-    op_calls_map[optype] += 1;
+  for (const data_op_site_stats_t &stats : *site_stats_ptr) {
+    const ompt_target_data_op_t optype = stats.optype;
+    op_time_map[optype] += stats.time;
+    op_bytes_map[optype] += stats.bytes;
+    op_calls_map[optype] += stats.calls;
   }
 
   // rank optypes by execution time
@@ -1303,7 +2071,7 @@ void print_summary(const std::vector<data_op_info_t> *data_op_log_ptr,
   }
 
   std::cerr << "\n=== OpenMP Target Data Operations Timing Summary ===\n";
-  if (data_op_log_ptr->empty()) {
+  if (site_stats_ptr->empty()) {
     std::cerr << "  no data operations profiled\n";
     return;
   }
@@ -1335,7 +2103,6 @@ void print_summary(const std::vector<data_op_info_t> *data_op_log_ptr,
   return;
 }
 
-#ifdef ENABLE_COLLISION_CHECKING
 void print_collision_summary(
     const std::map<HASH_T, std::set<data_info_t>> *collision_map_ptr) {
 
@@ -1373,11 +2140,9 @@ void free_data(
   }
   return;
 }
-#endif // ENABLE_COLLISION_CHECKING
 
-#ifdef MEASURE_HASHING_OVERHEAD
 void print_hash_overhead_summary(
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     duration<uint64_t, std::nano> overhead) {
   uint64_t count = 0;
   uint64_t bytes = 0;
@@ -1410,28 +2175,19 @@ void print_hash_overhead_summary(
   // clang-format on
   return;
 }
-#endif // MEASURE_HASHING_OVERHEAD
-
-#ifdef PRINT_SPACE_OVERHEAD
-void print_space_overhead_summary(
-    const std::vector<target_info_t> *target_log_ptr,
-    const std::vector<data_op_info_t> *data_op_log_ptr) {
-  const size_t target_log_size = target_log_ptr->size() * sizeof(target_info_t);
-  const size_t data_op_log_size =
-      data_op_log_ptr->size() * sizeof(data_op_info_t);
-  const size_t bytes = target_log_size + data_op_log_size;
 
+void print_space_overhead_summary(size_t event_bytes, size_t resident_bytes) {
   // clang-format off
   std::cerr << "\n  space overhead (B)   "
-            << format_uint(bytes, f_w) << "\n";
+            << format_uint(resident_bytes, f_w) << "\n";
+  std::cerr <<   "  logged events (B)   "
+            << format_uint(event_bytes, f_w) << "\n";
   // clang-format on
   return;
 }
-#endif // PRINT_SPACE_OVERHEAD
 
-#ifdef PRINT_TRANSFER_RATE
 void print_transfer_rate_summary(
-    const std::vector<data_op_info_t> *data_op_log_ptr) {
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr) {
   uint64_t count = 0;
   uint64_t bytes = 0;
   duration<uint64_t, std::nano> overhead(0);
@@ -1465,4 +2221,62 @@ void print_transfer_rate_summary(
   // clang-format on
   return;
 }
-#endif // PRINT_TRANSFER_RATE
+
+void set_list_lengths(size_t list_len, size_t sublist_len) {
+  f_list_len = list_len;
+  f_sublist_len = sublist_len;
+  return;
+}
+
+void run_analysis(Symbolizer &symbolizer,
+                  std::pmr::vector<target_info_t> *target_log_ptr,
+                  std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                  const std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                  std::vector<data_op_site_stats_t> *site_stats_ptr,
+                  duration<uint64_t, std::nano> exec_time, int num_devices,
+                  uint64_t sample_period, bool sample_random,
+                  const stream_results_t *stream_results) {
+  // ensure that event logs are in chronological order
+  std::sort(target_log_ptr->begin(), target_log_ptr->end(),
+            [](const target_info_t &a, const target_info_t &b) {
+              if (a.start_time != b.start_time) {
+                return a.start_time < b.start_time;
+              }
+              return a.end_time < b.end_time;
+            });
+  std::sort(data_op_log_ptr->begin(), data_op_log_ptr->end(),
+            [](const data_op_info_t &a, const data_op_info_t &b) {
+              if (a.start_time != b.start_time) {
+                return a.start_time < b.start_time;
+              }
+              return a.end_time < b.end_time;
+            });
+
+  // with sampling the log lacks most transfers, the statistics of each call
+  // site were kept as the program ran instead
+  sampling_info_t sampling;
+  if (sample_period > 1) {
+    get_sampling_info(sampling, site_stats_ptr, sample_period, sample_random);
+  } else if (stream_results == nullptr) {
+    get_data_op_site_stats(*site_stats_ptr, data_op_log_ptr);
+  }
+
+  if (stream_results != nullptr) {
+    analyze_stream_transfers(symbolizer, *stream_results, exec_time,
+                             num_devices);
+  } else {
+    analyze_inefficient_transfers(symbolizer, target_log_ptr, data_op_log_ptr,
+                                  exec_time, num_devices,
+                                  sample_period > 1 ? &sampling : nullptr);
+  }
+  analyze_codeptr_durations(symbolizer, site_stats_ptr, exec_time);
+  if (stream_results != nullptr) {
+    std::cerr << "\n=== OpenMP Target Region Data/Compute Analysis ===\n";
+    std::cerr << "  SKIPPED - not available in online mode\n";
+  } else {
+    analyze_regions(symbolizer, site_stats_ptr, target_log_ptr,
+                    data_op_log_ptr, kernel_log_ptr, exec_time);
+  }
+  print_summary(site_stats_ptr, exec_time);
+  return;
+}
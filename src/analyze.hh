@@ -1,14 +1,13 @@
 #pragma once
 
-#include <chrono>
-#include <set>
-#include <vector>
-
-#ifdef ENABLE_COLLISION_CHECKING
 #include <cassert>
+#include <chrono>
 #include <map>
+#include <memory_resource>
+#include <set>
 #include <string.h>
-#endif // ENABLE_COLLISION_CHECKING
+#include <tuple>
+#include <vector>
 
 #include <omp-tools.h>
 
@@ -22,12 +21,47 @@ typedef struct target_info {
   int device_num;
   // ompt_data_t *task_data;
   // ompt_data_t *target_task_data;
-  // ompt_data_t *target_data;
-  // const void *codeptr_ra;
+  // id the tool stored in the construct's target_data, the data ops and
+  // kernels of the construct carry the same id
+  uint64_t target_id;
+  const void *codeptr_ra;
   std::chrono::steady_clock::time_point start_time;
   std::chrono::steady_clock::time_point end_time;
 } target_info_t;
 
+/* Data structure used to store details about each kernel submission. The
+ * timestamps are those of the submit begin and end events, which depending on
+ * the runtime cover either the kernel launch alone or its whole execution.
+ * 'exec_time' is the execution time of the kernel traced on the device (see
+ * device_trace.hh), zero if the device was not traced.
+ */
+typedef struct kernel_info {
+  // id of the enclosing target construct
+  uint64_t target_id;
+  unsigned int requested_num_teams;
+  std::chrono::steady_clock::time_point start_time;
+  std::chrono::steady_clock::time_point end_time;
+  // id the tool gave the submission, the device trace records carry it too
+  uint64_t host_op_id;
+  std::chrono::duration<uint64_t, std::nano> exec_time;
+} kernel_info_t;
+
+/* Data movement and kernel execution of the target constructs issued from one
+ * call site.
+ */
+typedef struct region_stats {
+  const void *codeptr_ra;
+  uint64_t transfer_calls;
+  uint64_t transfer_bytes;
+  std::chrono::duration<uint64_t, std::nano> transfer_time;
+  uint64_t kernels;
+  // number of kernels whose execution was traced on the device
+  uint64_t traced_kernels;
+  // traced execution time of the kernels, or for those that were not traced
+  // the time between their submit begin and end events
+  std::chrono::duration<uint64_t, std::nano> kernel_time;
+} region_stats_t;
+
 /* Data structure used to store details about each data transfer event.
  */
 typedef struct data_op_info {
@@ -38,11 +72,82 @@ typedef struct data_op_info {
   int dest_device_num;
   size_t bytes;
   const void *codeptr_ra;
+  // id of the enclosing target construct (see target_info_t), zero for ops of
+  // target data, target enter/exit data and target update constructs
+  uint64_t target_id;
   std::chrono::steady_clock::time_point start_time;
   std::chrono::steady_clock::time_point end_time;
   HASH_T hash; // hash of transferred data, unused for alloc/delete
 } data_op_info_t;
 
+/* Exact statistics of the data ops of one type issued from one call site.
+ */
+typedef struct data_op_site_stats {
+  const void *codeptr_ra;
+  ompt_target_data_op_t optype;
+  uint64_t calls;
+  uint64_t bytes;
+  std::chrono::duration<uint64_t, std::nano> time;
+  std::chrono::duration<uint64_t, std::nano> min_time;
+  std::chrono::duration<uint64_t, std::nano> max_time;
+} data_op_site_stats_t;
+
+/* Describes how data transfers were sampled. Only the sampled transfers are
+ * in the data op log, the totals cover every transfer and are used to
+ * extrapolate the results of the analysis.
+ */
+typedef struct sampling_info {
+  uint64_t period; // about 1 in 'period' transfers is sampled
+  bool random;     // transfers are sampled at random rather than periodically
+  uint64_t transfer_calls;
+  uint64_t transfer_bytes;
+  std::chrono::duration<uint64_t, std::nano> transfer_time;
+} sampling_info_t;
+
+/* Duplicate transfers of the same data to one device detected online (see
+ * stream_detector.hh).
+ */
+typedef struct stream_duplicate {
+  int dest_device_num;
+  uint64_t size;
+  uint64_t calls;
+  std::chrono::duration<uint64_t, std::nano> time;
+  // calls from the most frequent (src_device_num, codeptr_ra) pairs
+  std::vector<std::tuple<uint64_t /*calls*/, int /*src_device_num*/,
+                         const void * /*codeptr_ra*/>>
+      sources;
+} stream_duplicate_t;
+
+/* Round trips of the same data between two devices detected online.
+ */
+typedef struct stream_round_trip {
+  int src_device_num;
+  int dest_device_num;
+  uint64_t size;
+  uint64_t trips;
+  std::chrono::duration<uint64_t, std::nano> time;
+  ompt_target_data_op_t tx_optype;
+  ompt_target_data_op_t rx_optype;
+  const void *tx_codeptr_ra;
+  const void *rx_codeptr_ra;
+} stream_round_trip_t;
+
+/* Results of online detection. The lists only hold the most costly issues,
+ * the totals cover every issue detected.
+ */
+typedef struct stream_results {
+  std::vector<stream_duplicate_t> duplicates;
+  std::vector<stream_round_trip_t> round_trips;
+  uint64_t pot_dd_calls;  // transfers of data already on the device
+  uint64_t pot_dd_hashes; // distinct data transferred more than once
+  uint64_t pot_rt_calls;
+  // totals over transfers that are duplicates, round trips or both
+  uint64_t pot_trans_calls;
+  uint64_t pot_trans_bytes;
+  std::chrono::duration<uint64_t, std::nano> pot_trans_time;
+  uint64_t evictions; // index entries forgotten to make room for new ones
+} stream_results_t;
+
 inline bool is_target_exec(ompt_target_t kind) {
   return (kind == ompt_target) || (kind == ompt_target_nowait);
 }
@@ -86,12 +191,13 @@ inline bool is_async_op(ompt_target_data_op_t optype) {
 }
 
 std::string format_uint(uint64_t value, int width);
-std::string format_float(float value, int width);
-std::string format_percent(float percent, int width, float precision,
-                           const std::string &label);
+std::string format_float(float value, int width, float precision,
+                         const std::string &label);
+std::string format_percent(float percent, int width);
 std::string format_duration(uint64_t ns, int width);
 std::string format_optype(ompt_target_data_op_t optype, int width);
 std::string format_symbol(Symbolizer &symbolizer, const void *codeptr_ra);
+std::string format_pattern(uint64_t pattern, int width);
 std::string format_device_num(int num_devices, int device_num, int width);
 
 std::string optype_to_string(ompt_target_data_op_t optype);
@@ -147,6 +253,13 @@ void print_unused_transfers(
                   std::vector<const data_op_info_t *>>>
         &unused_transfer_durations,
     std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
+void print_constant_transfers(
+    Symbolizer &symbolizer,
+    const std::set<
+        std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
+                  std::vector<const data_op_info_t *>>>
+        &constant_transfer_durations,
+    std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
 void print_potential_resource_savings(
     const std::set<
         std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
@@ -171,7 +284,13 @@ void print_potential_resource_savings(
         std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
                   std::vector<const data_op_info_t *>>>
         &unused_transfer_durations,
-    std::chrono::duration<uint64_t, std::nano> exec_time);
+    const std::set<
+        std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
+                  std::vector<const data_op_info_t *>>>
+        &constant_transfer_durations,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+    std::chrono::duration<uint64_t, std::nano> exec_time,
+    const sampling_info_t *sampling);
 void print_peak_device_memory_allocation(
     const std::vector<uint64_t> &peak_allocated_bytes);
 void analyze_duplicate_transfers(
@@ -180,7 +299,7 @@ void analyze_duplicate_transfers(
         std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
                   std::vector<const data_op_info_t *>>>
         &duplicate_transfer_durations,
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
 void analyze_round_trip_transfers(
     Symbolizer &symbolizer,
@@ -188,13 +307,13 @@ void analyze_round_trip_transfers(
         std::chrono::duration<uint64_t, std::nano> /*total_time*/,
         std::vector<std::pair<const data_op_info_t *, const data_op_info_t *>>>>
         &round_trip_durations,
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
 void get_allocation_pairs(
     std::vector<std::pair<const data_op_info_t * /*alloc*/,
                           const data_op_info_t * /*delete*/>> &alloc_log,
     std::vector<uint64_t> &peak_allocated_bytes,
-    const std::vector<data_op_info_t> *data_op_log_ptr, int num_devices);
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr, int num_devices);
 void analyze_repeated_allocs(
     Symbolizer &symbolizer,
     std::set<
@@ -207,7 +326,7 @@ void analyze_repeated_allocs(
     std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
 void get_device_target_log(
     std::vector<std::vector<const target_info_t *>> &device_target_log,
-    const std::vector<target_info_t> *target_log_ptr, int num_devices);
+    const std::pmr::vector<target_info_t> *target_log_ptr, int num_devices);
 void get_device_alloc_log(
     std::vector<std::vector<std::pair<const data_op_info_t * /*alloc*/,
                                       const data_op_info_t * /*delete*/>>>
@@ -218,7 +337,14 @@ void get_device_alloc_log(
 void get_device_transfer_log(
     std::vector<std::vector<const data_op_info_t * /*transfer*/>>
         &device_transfer_log,
-    const std::vector<data_op_info_t> *data_op_log_ptr, int num_devices);
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr, int num_devices);
+/* Returns true if a target region in 'target_log', which must be sorted by
+ * start time, started after 'begin' and no later than 'end'.
+ */
+bool target_started_between(
+    const std::vector<const target_info_t *> &target_log,
+    std::chrono::steady_clock::time_point begin,
+    std::chrono::steady_clock::time_point end);
 void analyze_unused_allocs(
     Symbolizer &symbolizer,
     std::set<
@@ -241,24 +367,75 @@ void analyze_unused_transfers(
     const std::vector<std::vector<const data_op_info_t * /*transfer*/>>
         &device_transfer_log,
     std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
-void analyze_inefficient_transfers(
-    Symbolizer &symbolizer, const std::vector<target_info_t> *target_log_ptr,
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+void analyze_constant_transfers(
+    Symbolizer &symbolizer,
+    std::set<
+        std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
+                  std::vector<const data_op_info_t *>>>
+        &constant_transfer_durations,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
+void analyze_inefficient_transfers(
+    Symbolizer &symbolizer,
+    const std::pmr::vector<target_info_t> *target_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+    std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices,
+    const sampling_info_t *sampling);
+void get_data_op_site_stats(
+    std::vector<data_op_site_stats_t> &site_stats,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr);
+void get_sampling_info(
+    sampling_info_t &sampling,
+    const std::vector<data_op_site_stats_t> *site_stats_ptr, uint64_t period,
+    bool random);
 void print_codeptr_durations(
     Symbolizer &symbolizer,
     const std::set<
         std::pair<std::chrono::duration<uint64_t, std::nano> /*total_time*/,
-                  std::vector<const data_op_info_t *>>> &codeptr_durations,
-    std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
+                  const data_op_site_stats_t *>> &codeptr_durations,
+    std::chrono::duration<uint64_t, std::nano> exec_time);
 void analyze_codeptr_durations(
-    Symbolizer &symbolizer, const std::vector<data_op_info_t> *data_op_log_ptr,
+    Symbolizer &symbolizer,
+    const std::vector<data_op_site_stats_t> *site_stats_ptr,
     std::chrono::duration<uint64_t, std::nano> exec_time);
-void print_summary(const std::vector<data_op_info_t> *data_op_log_ptr,
+void print_summary(const std::vector<data_op_site_stats_t> *site_stats_ptr,
                    std::chrono::duration<uint64_t, std::nano> exec_time);
+void print_region_stats(Symbolizer &symbolizer,
+                        const std::vector<region_stats_t> &region_stats,
+                        std::chrono::duration<uint64_t, std::nano> exec_time);
+void analyze_regions(Symbolizer &symbolizer,
+                     const std::vector<data_op_site_stats_t> *site_stats_ptr,
+                     const std::pmr::vector<target_info_t> *target_log_ptr,
+                     const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                     const std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                     std::chrono::duration<uint64_t, std::nano> exec_time);
+void analyze_stream_transfers(
+    Symbolizer &symbolizer, const stream_results_t &results,
+    std::chrono::duration<uint64_t, std::nano> exec_time, int num_devices);
 
-#ifdef ENABLE_COLLISION_CHECKING
+/* Sets the maximum number of issues listed in each section of the report and
+ * the maximum number of call sites listed for each issue.
+ */
+void set_list_lengths(size_t list_len, size_t sublist_len);
 
+/* Runs every analysis on the merged event logs and prints the report. The logs
+ * must hold steady_clock timestamps. If 'stream_results' is not nullptr the
+ * transfers were classified online and the logs are empty. When
+ * transfers were sampled or classified online, 'site_stats_ptr' must hold the
+ * statistics kept while the program ran, otherwise it is filled in from the
+ * data op log.
+ */
+void run_analysis(Symbolizer &symbolizer,
+                  std::pmr::vector<target_info_t> *target_log_ptr,
+                  std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                  const std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                  std::vector<data_op_site_stats_t> *site_stats_ptr,
+                  std::chrono::duration<uint64_t, std::nano> exec_time,
+                  int num_devices, uint64_t sample_period, bool sample_random,
+                  const stream_results_t *stream_results);
+
+/* Copy of the data of a transfer, kept when checking for hash collisions.
+ */
 typedef struct data_info {
   void *data;
   size_t bytes;
@@ -298,21 +475,11 @@ void print_collision_summary(
 void free_data(
     const std::map<HASH_T, std::set<data_info_t>> *collision_map_ptr);
 
-#endif // ENABLE_COLLISION_CHECKING
-
-#ifdef MEASURE_HASHING_OVERHEAD
 void print_hash_overhead_summary(
-    const std::vector<data_op_info_t> *data_op_log_ptr,
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
     std::chrono::duration<uint64_t, std::nano> overhead);
-#endif // MEASURE_HASHING_OVERHEAD
 
-#ifdef PRINT_SPACE_OVERHEAD
-void print_space_overhead_summary(
-    const std::vector<target_info_t> *target_log_ptr,
-    const std::vector<data_op_info_t> *data_op_log_ptr);
-#endif // PRINT_SPACE_OVERHEAD
+void print_space_overhead_summary(size_t event_bytes, size_t resident_bytes);
 
-#ifdef PRINT_TRANSFER_RATE
 void print_transfer_rate_summary(
-    const std::vector<data_op_info_t> *data_op_log_ptr);
-#endif // PRINT_TRANSFER_RATE
+    const std::pmr::vector<data_op_info_t> *data_op_log_ptr);
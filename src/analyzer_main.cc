@@ -0,0 +1,140 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <vector>
+
+#include "analyze.hh"
+#include "symbolizer.hh"
+#include "trace.hh"
+
+using namespace std::chrono;
+
+const char *OMPDATAPERF_VERSION = "0.0.1-alpha";
+
+void print_help() {
+  std::cout << "Usage: ompdataperf-analyze [options] [trace]\n";
+  std::cout << "Options:\n";
+  std::cout << "  -h, --help              Show this help message\n";
+  std::cout << "  -v, --verbose           Enable verbose output\n";
+  std::cout << "  -n, --list-len <n>      Maximum number of issues listed in "
+               "each section (default 24)\n";
+  std::cout << "  --sublist-len <n>       Maximum number of call sites listed "
+               "for each issue (default 8)\n";
+  std::cout << "  --version               Print the version of ompdataperf\n";
+}
+
+void print_version() {
+  std::cout << "ompdataperf-analyze version " << OMPDATAPERF_VERSION << "\n";
+}
+
+/* Parses a list length given on the command line. Returns on success,
+ * otherwise prints an error message and exits.
+ */
+size_t parse_list_len(const char *name, const char *value) {
+  char *end = nullptr;
+  const long long len = strtoll(value, &end, 10);
+  if (end == value || *end != '\0' || len < 1) {
+    std::cerr << "error: invalid " << name << " '" << value << "'\n";
+    exit(EXIT_FAILURE);
+  }
+  return len;
+}
+
+int main(int argc, char *argv[]) {
+  // default values for options
+  int verbose = false;
+  size_t list_len = 24;
+  size_t sublist_len = 8;
+
+  // clang-format off
+  static struct option long_options[] = {
+    {"help",        no_argument,       nullptr, 'h'},
+    {"verbose",     no_argument,       nullptr, 'v'},
+    {"list-len",    required_argument, nullptr, 'n'},
+    {"sublist-len", required_argument, nullptr,  0 },
+    {"version",     no_argument,       nullptr,  0 },
+    {nullptr,       0,                 nullptr,  0 }
+  };
+  // clang-format on
+
+  int option_index = 0;
+  int c;
+  // parse options
+  while ((c = getopt_long(argc, argv, "hvn:", long_options, &option_index)) !=
+         -1) {
+    switch (c) {
+    case 'h':
+      print_help();
+      return 0;
+    case 'v':
+      verbose = true;
+      break;
+    case 'n':
+      list_len = parse_list_len("list length", optarg);
+      break;
+    case 0: // handle long options with no short equivalent
+      if (strcmp(long_options[option_index].name, "version") == 0) {
+        print_version();
+        return 0;
+      }
+      if (strcmp(long_options[option_index].name, "sublist-len") == 0) {
+        sublist_len = parse_list_len("sublist length", optarg);
+      }
+      break;
+    case '?':
+      // getopt_long already printed an error message.
+      return 1;
+    default:
+      return 1;
+    }
+  }
+
+  if (optind == argc) {
+    std::cerr << "error: no trace specified to analyze\n";
+    return 1;
+  }
+  const char *trace_path = argv[optind];
+
+  const steady_clock::time_point analysis_start = steady_clock::now();
+
+  trace_info_t info;
+  std::pmr::vector<target_info_t> target_log;
+  std::pmr::vector<data_op_info_t> data_op_log;
+  std::pmr::vector<kernel_info_t> kernel_log;
+  std::vector<data_op_site_stats_t> site_stats;
+  if (!read_trace(trace_path, info, &target_log, &data_op_log, &kernel_log,
+                  &site_stats)) {
+    return 1;
+  }
+  if (verbose) {
+    std::cerr << "info: read " << target_log.size() << " target events and "
+              << data_op_log.size() << " data op events from '" << trace_path
+              << "'\n";
+    std::cerr << "info: data transfers were hashed with " << info.hash_name
+              << " (" << info.hash_bits << " bit)\n";
+  }
+
+  set_list_lengths(list_len, sublist_len);
+  Symbolizer symbolizer(info.maps, verbose);
+  run_analysis(symbolizer, &target_log, &data_op_log, &kernel_log, &site_stats,
+               info.exec_time, info.num_devices, info.sample_period,
+               info.sample_random, nullptr);
+
+  const steady_clock::time_point analysis_end = steady_clock::now();
+  const duration<uint64_t, std::nano> analysis_time =
+      analysis_end - analysis_start;
+
+  // clang-format off
+  std::cerr << "\n  execution time "
+            << format_duration(info.exec_time.count(), 10) << "\n";
+  std::cerr <<   "  analysis time  "
+            << format_duration(analysis_time.count(), 10) << "\n";
+  // clang-format on
+
+  if (symbolizer.has_errmsg()) {
+    std::cerr << "\n" << symbolizer.get_errmsg() << "\n";
+  }
+  return 0;
+}
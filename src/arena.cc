@@ -0,0 +1,449 @@
+#include "arena.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+// size of each region reserved from the operating system, regions are mapped
+// with MAP_NORESERVE so untouched pages do not consume memory
+constexpr size_t k_region_bytes = 1024ull * 1024 * 1024;
+constexpr size_t k_huge_page_bytes = 2 * 1024 * 1024;
+
+/* Header stored at the start of every region.
+ */
+typedef struct region {
+  struct region *next;
+  size_t size;
+  std::atomic<size_t> offset;
+} region_t;
+
+std::atomic<region_t *> s_region = nullptr;
+std::mutex s_region_mutex;
+std::atomic<size_t> s_bytes_allocated = 0;
+bool s_huge_pages = false;
+
+// spilling is disabled while s_spill_fd is negative
+int s_spill_fd = -1;
+size_t s_max_bytes = 0;
+std::atomic<size_t> s_spill_offset = 0;
+std::atomic<bool> s_spill_failed = false;
+
+/* Full chunks are written to the spill file by a writer thread, so that the
+ * threads reporting events never wait for the disk. A log hands its full chunk
+ * to the writer and continues in a chunk the writer is done with, a new chunk
+ * being taken from the arena while fewer than k_max_spill_in_flight chunks are
+ * waiting to be written.
+ */
+constexpr size_t k_max_spill_in_flight = 8;
+std::mutex s_spill_mutex;
+// signaled when a chunk is queued or the writer is asked to stop
+std::condition_variable s_spill_queued_cv;
+// signaled when the writer is done with a chunk
+std::condition_variable s_spill_written_cv;
+std::deque<std::pair<void * /*chunk*/, int64_t /*offset*/>> s_spill_queue;
+// chunks queued or being written
+size_t s_spill_in_flight = 0;
+// written chunks, ready to be reused
+std::vector<void *> s_spill_free;
+// chunks that failed to be written, which stay in memory instead
+std::map<int64_t /*offset*/, void * /*chunk*/> s_spill_unwritten;
+std::thread s_spill_writer;
+bool s_spill_stopped = false;
+// cpu time of the writer thread, set when it stops
+uint64_t s_spill_cpu_ns = 0;
+
+// ranges of the spill file handed out by the log memory resource
+std::mutex s_mapped_mutex;
+std::map<void * /*ptr*/, std::pair<int64_t /*offset*/, size_t /*bytes*/>>
+    s_mapped;
+
+size_t align_up(size_t value, size_t align) {
+  return (value + align - 1) & ~(align - 1);
+}
+
+void *map_region(size_t bytes) {
+  constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void *ptr = MAP_FAILED;
+  if (s_huge_pages) {
+    // Explicit huge pages require the administrator to reserve a pool of them,
+    // so this commonly fails. MAP_NORESERVE is not used here since touching an
+    // unreserved huge page raises SIGBUS instead of failing the mapping.
+    ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1,
+               0);
+  }
+  if (ptr == MAP_FAILED) {
+    ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags | MAP_NORESERVE,
+               -1, 0);
+    if (ptr == MAP_FAILED) {
+      return nullptr;
+    }
+    if (s_huge_pages) {
+      madvise(ptr, bytes, MADV_HUGEPAGE);
+    }
+  }
+  return ptr;
+}
+
+/* Maps a new region large enough to satisfy an allocation of 'bytes' bytes
+ * aligned to 'align' bytes and makes it the current region. Returns false if
+ * the mapping fails.
+ */
+bool grow(region_t *current, size_t bytes, size_t align) {
+  std::lock_guard<std::mutex> lock(s_region_mutex);
+  if (s_region.load(std::memory_order_acquire) != current) {
+    // another thread already grew the arena
+    return true;
+  }
+  const size_t size = align_up(
+      std::max(k_region_bytes, sizeof(region_t) + bytes + align),
+      k_huge_page_bytes);
+  region_t *r = static_cast<region_t *>(map_region(size));
+  if (r == nullptr) {
+    std::cerr << "warning: failed to map " << size
+              << " bytes for the event log. " << strerror(errno) << "\n";
+    return false;
+  }
+  r->next = current;
+  r->size = size;
+  r->offset.store(sizeof(region_t), std::memory_order_relaxed);
+  s_region.store(r, std::memory_order_release);
+  return true;
+}
+} // namespace
+
+void arena_init(bool huge_pages) { s_huge_pages = huge_pages; }
+
+void *arena_alloc(size_t bytes, size_t align) {
+  bytes = align_up(bytes, align);
+  while (true) {
+    region_t *r = s_region.load(std::memory_order_acquire);
+    if (r != nullptr) {
+      const uintptr_t base = reinterpret_cast<uintptr_t>(r);
+      size_t offset = r->offset.load(std::memory_order_relaxed);
+      while (true) {
+        const size_t start = align_up(base + offset, align) - base;
+        if (start + bytes > r->size) {
+          break;
+        }
+        if (r->offset.compare_exchange_weak(offset, start + bytes,
+                                            std::memory_order_relaxed)) {
+          s_bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+          return reinterpret_cast<void *>(base + start);
+        }
+      }
+    }
+    if (!grow(r, bytes, align)) {
+      return nullptr;
+    }
+  }
+}
+
+void arena_discard(void *ptr, size_t bytes) {
+  madvise(ptr, bytes, MADV_DONTNEED);
+  return;
+}
+
+size_t arena_bytes_allocated() {
+  return s_bytes_allocated.load(std::memory_order_relaxed);
+}
+
+bool arena_init_spill(size_t max_bytes, const char *dir) {
+  // the file is never linked into the file system when O_TMPFILE is supported
+  int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    std::string path = std::string(dir) + "/ompdataperf-spill-XXXXXX";
+    fd = mkostemp(path.data(), O_CLOEXEC);
+    if (fd >= 0) {
+      unlink(path.c_str());
+    }
+  }
+  if (fd < 0) {
+    std::cerr << "warning: failed to create a spill file in '" << dir
+              << "', the memory budget is ignored. " << strerror(errno)
+              << "\n";
+    return false;
+  }
+  s_spill_fd = fd;
+  s_max_bytes = max_bytes;
+  return true;
+}
+
+bool arena_over_budget() {
+  return s_spill_fd >= 0 && !s_spill_failed.load(std::memory_order_relaxed) &&
+         s_bytes_allocated.load(std::memory_order_relaxed) > s_max_bytes;
+}
+
+namespace {
+/* Writes the k_arena_chunk_bytes bytes of 'chunk' to the spill file at
+ * 'offset'. Returns false if the write failed.
+ */
+bool write_chunk(const void *chunk, int64_t offset) {
+  size_t done = 0;
+  while (done < k_arena_chunk_bytes) {
+    const ssize_t ret =
+        pwrite(s_spill_fd, static_cast<const char *>(chunk) + done,
+               k_arena_chunk_bytes - done, offset + done);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      // stop spilling so that logs go back to growing in memory
+      if (!s_spill_failed.exchange(true, std::memory_order_relaxed)) {
+        std::cerr << "warning: failed to write to the spill file, the memory "
+                     "budget is no longer enforced. "
+                  << strerror(errno) << "\n";
+      }
+      return false;
+    }
+    done += ret;
+  }
+  return true;
+}
+
+/* Hands a chunk the writer is done with back to the logs. Must be called with
+ * s_spill_mutex held.
+ */
+void finish_chunk(void *chunk, int64_t offset, bool written) {
+  if (written) {
+    s_spill_free.push_back(chunk);
+  } else {
+    s_spill_unwritten.emplace(offset, chunk);
+  }
+  return;
+}
+
+void spill_writer_main() {
+  std::unique_lock<std::mutex> lock(s_spill_mutex);
+  while (true) {
+    s_spill_queued_cv.wait(
+        lock, [] { return !s_spill_queue.empty() || s_spill_stopped; });
+    if (s_spill_queue.empty()) {
+      struct timespec ts;
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        s_spill_cpu_ns = ts.tv_sec * 1'000'000'000ull + ts.tv_nsec;
+      }
+      return;
+    }
+    const auto [chunk, offset] = s_spill_queue.front();
+    s_spill_queue.pop_front();
+    lock.unlock();
+    const bool written = write_chunk(chunk, offset);
+    lock.lock();
+    finish_chunk(chunk, offset, written);
+    s_spill_in_flight -= 1;
+    s_spill_written_cv.notify_all();
+  }
+}
+} // namespace
+
+int64_t arena_spill(void *chunk) {
+  const int64_t offset =
+      s_spill_offset.fetch_add(k_arena_chunk_bytes, std::memory_order_relaxed);
+  std::unique_lock<std::mutex> lock(s_spill_mutex);
+  if (s_spill_stopped) {
+    // events reported after the writer stopped are spilled synchronously
+    lock.unlock();
+    const bool written = write_chunk(chunk, offset);
+    lock.lock();
+    finish_chunk(chunk, offset, written);
+    return offset;
+  }
+  if (!s_spill_writer.joinable()) {
+    s_spill_writer = std::thread(spill_writer_main);
+  }
+  s_spill_queue.emplace_back(chunk, offset);
+  s_spill_in_flight += 1;
+  s_spill_queued_cv.notify_one();
+  return offset;
+}
+
+void *arena_spare_chunk() {
+  std::unique_lock<std::mutex> lock(s_spill_mutex);
+  while (s_spill_free.empty()) {
+    if (s_spill_in_flight < k_max_spill_in_flight) {
+      lock.unlock();
+      return arena_alloc(k_arena_chunk_bytes, alignof(std::max_align_t));
+    }
+    s_spill_written_cv.wait(lock);
+  }
+  void *chunk = s_spill_free.back();
+  s_spill_free.pop_back();
+  return chunk;
+}
+
+void arena_spill_flush() {
+  std::unique_lock<std::mutex> lock(s_spill_mutex);
+  s_spill_written_cv.wait(lock, [] { return s_spill_in_flight == 0; });
+  return;
+}
+
+void arena_spill_shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(s_spill_mutex);
+    s_spill_stopped = true;
+  }
+  s_spill_queued_cv.notify_all();
+  if (s_spill_writer.joinable()) {
+    s_spill_writer.join();
+  }
+  return;
+}
+
+std::chrono::duration<uint64_t, std::nano> arena_spill_cpu_time() {
+  std::lock_guard<std::mutex> lock(s_spill_mutex);
+  return std::chrono::duration<uint64_t, std::nano>(s_spill_cpu_ns);
+}
+
+const void *arena_map_spilled(int64_t offset, size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(s_spill_mutex);
+    const auto it = s_spill_unwritten.find(offset);
+    if (it != s_spill_unwritten.end()) {
+      return it->second;
+    }
+  }
+  void *ptr = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, s_spill_fd, offset);
+  if (ptr == MAP_FAILED) {
+    std::cerr << "warning: failed to map the spill file, some events are "
+                 "missing from the analysis. "
+              << strerror(errno) << "\n";
+    return nullptr;
+  }
+  madvise(ptr, bytes, MADV_SEQUENTIAL);
+  return ptr;
+}
+
+void arena_unmap_spilled(const void *ptr, size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(s_spill_mutex);
+    for (const auto &[offset, chunk] : s_spill_unwritten) {
+      if (chunk == ptr) {
+        return;
+      }
+    }
+  }
+  munmap(const_cast<void *>(ptr), bytes);
+  return;
+}
+
+void arena_release_spilled(int64_t offset, size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(s_spill_mutex);
+    const auto it = s_spill_unwritten.find(offset);
+    if (it != s_spill_unwritten.end()) {
+      arena_discard(it->second, bytes);
+      s_spill_unwritten.erase(it);
+      return;
+    }
+  }
+  fallocate(s_spill_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+            bytes);
+  return;
+}
+
+size_t arena_bytes_spilled() {
+  return s_spill_offset.load(std::memory_order_relaxed);
+}
+
+namespace {
+/* Memory resource backed by the spill file, see arena_log_resource(). Each
+ * allocation is a shared mapping of a range of the file appended for it, so
+ * its pages are written back to the file and dropped under memory pressure
+ * instead of being held in anonymous memory.
+ */
+class SpillResource : public std::pmr::memory_resource {
+  void *do_allocate(size_t bytes, size_t align) override {
+    std::pmr::memory_resource *fallback = std::pmr::new_delete_resource();
+    if (s_spill_fd < 0 || s_spill_failed.load(std::memory_order_relaxed) ||
+        align > k_arena_chunk_bytes) {
+      return fallback->allocate(bytes, align);
+    }
+    // offsets of the spill file stay multiples of the chunk size
+    const size_t size =
+        align_up(std::max<size_t>(bytes, 1), k_arena_chunk_bytes);
+    const int64_t offset =
+        s_spill_offset.fetch_add(size, std::memory_order_relaxed);
+    // the range is allocated up front, a shared mapping of a hole in a file
+    // system that runs out of space would raise SIGBUS
+    if (fallocate(s_spill_fd, 0, offset, size) != 0) {
+      return fallback->allocate(bytes, align);
+    }
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     s_spill_fd, offset);
+    if (ptr == MAP_FAILED) {
+      fallocate(s_spill_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+                size);
+      return fallback->allocate(bytes, align);
+    }
+    std::lock_guard<std::mutex> lock(s_mapped_mutex);
+    s_mapped.emplace(ptr, std::make_pair(offset, size));
+    return ptr;
+  }
+
+  void do_deallocate(void *ptr, size_t bytes, size_t align) override {
+    {
+      std::lock_guard<std::mutex> lock(s_mapped_mutex);
+      const auto it = s_mapped.find(ptr);
+      if (it != s_mapped.end()) {
+        const auto [offset, size] = it->second;
+        s_mapped.erase(it);
+        munmap(ptr, size);
+        fallocate(s_spill_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  offset, size);
+        return;
+      }
+    }
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+    return;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+};
+
+SpillResource s_spill_resource;
+
+/* Memory resource backed by the arena, see arena_resource().
+ */
+class ArenaResource : public std::pmr::memory_resource {
+  void *do_allocate(size_t bytes, size_t align) override {
+    void *ptr = arena_alloc(std::max<size_t>(bytes, 1), align);
+    if (ptr == nullptr) {
+      return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    return ptr;
+  }
+
+  void do_deallocate(void * /*ptr*/, size_t /*bytes*/,
+                     size_t /*align*/) override {
+    return;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+};
+
+ArenaResource s_arena_resource;
+} // namespace
+
+std::pmr::memory_resource *arena_log_resource() { return &s_spill_resource; }
+
+std::pmr::memory_resource *arena_resource() { return &s_arena_resource; }
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* The arena is an append-only memory pool used to store everything the tool
+ * records while the user's program runs. Memory is taken from large private
+ * mmap regions instead of the application's malloc heap, and allocation is a
+ * single atomic bump of the current region.
+ *
+ * When a memory budget is set, event logs stop growing once the arena has
+ * handed out more than the budget. Instead, their full chunks are handed to a
+ * writer thread that appends them to an unlinked spill file, and the logs
+ * continue in chunks the writer is done with. Spilled chunks are mapped back
+ * in when the logs are read, and the merged logs are kept in the spill file
+ * too (see arena_log_resource()).
+ */
+
+// size of the chunks that event logs are built from
+constexpr size_t k_arena_chunk_bytes = 2 * 1024 * 1024;
+
+/* Sets up the arena. If 'huge_pages' is true the arena tries to back its
+ * regions with huge pages, falling back to transparent huge pages and then to
+ * regular pages.
+ */
+void arena_init(bool huge_pages);
+
+/* Allocates 'bytes' bytes aligned to 'align' bytes, which must be a power of
+ * two. The returned memory is zero-initialized and is never freed. Returns
+ * nullptr if the arena cannot be grown.
+ */
+void *arena_alloc(size_t bytes, size_t align);
+
+/* Returns the physical memory backing [ptr, ptr + bytes) to the operating
+ * system. The range remains mapped and reads back as zeros.
+ */
+void arena_discard(void *ptr, size_t bytes);
+
+/* Returns the number of bytes handed out by the arena so far.
+ */
+size_t arena_bytes_allocated();
+
+/* Sets a budget of 'max_bytes' bytes after which event logs spill to a file
+ * created in the directory 'dir'. Returns false, leaving spilling disabled, if
+ * the file cannot be created.
+ */
+bool arena_init_spill(size_t max_bytes, const char *dir);
+
+/* Returns true if spilling is enabled and the arena has handed out more than
+ * the budget.
+ */
+bool arena_over_budget();
+
+/* Queues the k_arena_chunk_bytes bytes chunk 'chunk' to be appended to the
+ * spill file by the writer thread, which takes ownership of it. Returns the
+ * offset it is written at. If the write fails the chunk is kept in memory and
+ * returned by arena_map_spilled() instead. Thread safe.
+ */
+int64_t arena_spill(void *chunk);
+
+/* Returns a chunk to replace one passed to arena_spill(): one the writer is
+ * done with, or a new one taken from the arena if few chunks are waiting to be
+ * written. Otherwise waits for the writer. Returns nullptr if the arena is out
+ * of memory. Thread safe.
+ */
+void *arena_spare_chunk();
+
+/* Waits until every chunk passed to arena_spill() has been written.
+ */
+void arena_spill_flush();
+
+/* Writes the remaining chunks and stops the writer thread. Chunks spilled
+ * afterwards are written by the calling thread.
+ */
+void arena_spill_shutdown();
+
+/* Returns the cpu time used by the spill writer thread. Only complete once the
+ * writer has been stopped by arena_spill_shutdown().
+ */
+std::chrono::duration<uint64_t, std::nano> arena_spill_cpu_time();
+
+/* Maps 'bytes' bytes of the spill file starting at 'offset', as returned by
+ * arena_spill(), read only. Returns nullptr if the mapping fails.
+ */
+const void *arena_map_spilled(int64_t offset, size_t bytes);
+
+/* Unmaps a range returned by arena_map_spilled().
+ */
+void arena_unmap_spilled(const void *ptr, size_t bytes);
+
+/* Returns the disk space held by a range of the spill file to the file system.
+ */
+void arena_release_spilled(int64_t offset, size_t bytes);
+
+/* Returns the number of bytes written to the spill file so far.
+ */
+size_t arena_bytes_spilled();
+
+/* Memory resource for the merged event logs. When spilling is enabled their
+ * storage is a shared mapping of the spill file, so that the decoded logs do
+ * not hold the memory the budget was meant to bound. Otherwise, or if the file
+ * cannot be extended, memory comes from the default resource.
+ */
+std::pmr::memory_resource *arena_log_resource();
+
+/* Memory resource for the containers of per-thread bookkeeping, such as call
+ * site tables, that are filled from the callbacks. Memory comes from the arena
+ * and, like the rest of the arena, is never freed: deallocation is a no-op,
+ * so containers that grow leave their previous storage behind. Falls back to
+ * the default resource, whose memory is not freed either, if the arena cannot
+ * be grown. Thread safe.
+ */
+std::pmr::memory_resource *arena_resource();
+
+/* List of k_arena_chunk_bytes sized chunks taken from the arena, from which
+ * event logs are built. Each chunk starts with a header, the meaning of 'size'
+ * and of the rest of the chunk is up to the owner of the list.
+ *
+ * Once the arena is over budget the list stops taking new chunks. When asked
+ * to grow, the last chunk is handed to the spill writer and replaced by a
+ * spare chunk instead, so the chunks of the list are, in order, those taken
+ * before the first spill, then the spilled chunks, then the last chunk and
+ * any chunk taken after spilling failed.
+ */
+class ChunkList {
+public:
+  typedef struct chunk {
+    struct chunk *next;
+    size_t size;
+  } chunk_t;
+
+private:
+  chunk_t *m_head = nullptr;
+  chunk_t *m_tail = nullptr;
+  // the chunk before m_tail, if any
+  chunk_t *m_prev = nullptr;
+  // offsets in the spill file of the chunks spilled so far
+  std::vector<int64_t> m_spilled;
+  // the first chunk in memory that comes after the spilled chunks, chunks
+  // taken once spilling has stopped follow it
+  chunk_t *m_after_spilled = nullptr;
+  // number of chunks held in memory
+  size_t m_resident = 0;
+
+  /* Hands the last chunk to the spill writer and replaces it with an empty
+   * spare chunk. Returns false if there is no spare chunk.
+   */
+  bool spill_tail() {
+    chunk_t *c = static_cast<chunk_t *>(arena_spare_chunk());
+    if (c == nullptr) {
+      return false;
+    }
+    c->next = nullptr;
+    c->size = 0;
+    m_spilled.push_back(arena_spill(m_tail));
+    if (m_prev == nullptr) {
+      m_head = c;
+    } else {
+      m_prev->next = c;
+    }
+    if (m_after_spilled == nullptr || m_after_spilled == m_tail) {
+      m_after_spilled = c;
+    }
+    m_tail = c;
+    return true;
+  }
+
+public:
+  chunk_t *tail() const { return m_tail; }
+
+  /* Returns the number of bytes of the chunks held in memory, whether or not
+   * they are full. Spilled chunks are not counted.
+   */
+  size_t resident_bytes() const { return m_resident * k_arena_chunk_bytes; }
+
+  /* Makes an empty chunk the last chunk of the list. Returns false if the
+   * arena is out of memory.
+   */
+  bool grow() {
+    if (m_tail != nullptr && arena_over_budget() && spill_tail()) {
+      return true;
+    }
+    chunk_t *c = static_cast<chunk_t *>(
+        arena_alloc(k_arena_chunk_bytes, alignof(std::max_align_t)));
+    if (c == nullptr) {
+      return false;
+    }
+    c->next = nullptr;
+    c->size = 0;
+    if (m_tail == nullptr) {
+      m_head = c;
+    } else {
+      m_tail->next = c;
+    }
+    m_prev = m_tail;
+    m_tail = c;
+    ++m_resident;
+    return true;
+  }
+
+  /* Calls 'fn' on every chunk in order.
+   */
+  template <typename Fn> void for_each_chunk(Fn &&fn) const {
+    const chunk_t *c = m_head;
+    if (!m_spilled.empty()) {
+      arena_spill_flush();
+      for (; c != m_after_spilled; c = c->next) {
+        fn(c);
+      }
+      for (int64_t offset : m_spilled) {
+        const chunk_t *spilled = static_cast<const chunk_t *>(
+            arena_map_spilled(offset, k_arena_chunk_bytes));
+        if (spilled == nullptr) {
+          continue;
+        }
+        fn(spilled);
+        arena_unmap_spilled(spilled, k_arena_chunk_bytes);
+      }
+    }
+    for (; c != nullptr; c = c->next) {
+      fn(c);
+    }
+  }
+
+  /* Empties the list and returns the memory held by its chunks to the
+   * operating system.
+   */
+  void release() {
+    chunk_t *c = m_head;
+    while (c != nullptr) {
+      chunk_t *next = c->next;
+      arena_discard(c, k_arena_chunk_bytes);
+      c = next;
+    }
+    for (int64_t offset : m_spilled) {
+      arena_release_spilled(offset, k_arena_chunk_bytes);
+    }
+    m_spilled.clear();
+    m_spilled.shrink_to_fit();
+    m_head = nullptr;
+    m_tail = nullptr;
+    m_prev = nullptr;
+    m_after_spilled = nullptr;
+    m_resident = 0;
+  }
+};
+
+/* Append-only log of fixed size entries built from a ChunkList. Appending
+ * never moves existing entries, so the cost of an append does not depend on the
+ * number of entries already in the log. A ChunkedLog has a single writer.
+ */
+template <typename T> class ChunkedLog {
+  static_assert(std::is_trivially_destructible_v<T>);
+
+private:
+  typedef ChunkList::chunk_t chunk_t;
+
+  static constexpr size_t k_entries_offset =
+      (sizeof(chunk_t) + alignof(T) - 1) / alignof(T) * alignof(T);
+  static constexpr size_t k_chunk_capacity =
+      (k_arena_chunk_bytes - k_entries_offset) / sizeof(T);
+
+  ChunkList m_chunks;
+  size_t m_size = 0;
+
+  static T *entries(const chunk_t *c) {
+    return reinterpret_cast<T *>(reinterpret_cast<uintptr_t>(c) +
+                                 k_entries_offset);
+  }
+
+public:
+  /* Constructs a new entry at the end of the log. Returns false, and drops the
+   * entry, if the arena is out of memory.
+   */
+  template <typename... Args> bool emplace_back(Args &&...args) {
+    chunk_t *tail = m_chunks.tail();
+    if (tail == nullptr || tail->size == k_chunk_capacity) [[unlikely]] {
+      if (!m_chunks.grow()) {
+        return false;
+      }
+      tail = m_chunks.tail();
+    }
+    new (&entries(tail)[tail->size]) T(std::forward<Args>(args)...);
+    ++tail->size;
+    ++m_size;
+    return true;
+  }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  size_t resident_bytes() const { return m_chunks.resident_bytes(); }
+
+  /* Calls 'fn' on every entry in the order they were appended.
+   */
+  template <typename Fn> void for_each(Fn &&fn) const {
+    m_chunks.for_each_chunk([&fn](const chunk_t *c) {
+      const T *e = entries(c);
+      for (size_t i = 0; i < c->size; ++i) {
+        fn(e[i]);
+      }
+    });
+  }
+
+  /* Empties the log and returns the memory held by its chunks to the
+   * operating system.
+   */
+  void release() {
+    m_chunks.release();
+    m_size = 0;
+  }
+};
@@ -0,0 +1,73 @@
+#include "clock.hh"
+
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+using namespace std::chrono;
+
+namespace {
+/* Returns true if the processor has an invariant TSC, i.e. one that ticks at a
+ * constant rate regardless of frequency scaling and sleep states.
+ */
+bool has_invariant_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+  return (edx & (1u << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+bool has_rdtscp() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+  return (edx & (1u << 27)) != 0;
+#else
+  return false;
+#endif
+}
+} // namespace
+
+void ToolClock::init(bool use_tsc) {
+  s_use_tsc = false;
+  if (use_tsc) {
+    if (has_invariant_tsc()) {
+      s_use_tsc = true;
+      s_use_rdtscp = has_rdtscp();
+    } else {
+      std::cerr << "warning: processor does not have an invariant TSC. "
+                   "Falling back to steady_clock.\n";
+    }
+  }
+  if (s_use_tsc) {
+    s_steady_begin = steady_clock::now().time_since_epoch().count();
+    s_tsc_begin = read_tsc();
+  }
+  return;
+}
+
+void ToolClock::calibrate() {
+  if (!s_use_tsc) {
+    return;
+  }
+  const uint64_t tsc_end = read_tsc();
+  const int64_t steady_end = steady_clock::now().time_since_epoch().count();
+  const uint64_t ticks = tsc_end - s_tsc_begin;
+  const uint64_t ns = steady_end - s_steady_begin;
+  if (ticks == 0) {
+    s_ns_per_tick = 0;
+    return;
+  }
+  __extension__ typedef unsigned __int128 uint128_t;
+  s_ns_per_tick = (static_cast<uint128_t>(ns) << 32) / ticks;
+  return;
+}
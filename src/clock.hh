@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Source of the timestamps recorded for each event. By default this is
+ * std::chrono::steady_clock. Optionally the invariant time stamp counter (TSC)
+ * is read directly, which is considerably cheaper on some systems (notably
+ * virtual machines where steady_clock may not be serviced by the vDSO).
+ *
+ * Timestamps returned by ToolClock::now() are raw: with the TSC they count
+ * ticks rather than nanoseconds. They are stored as steady_clock time points
+ * so that events can hold either kind, but must be converted with
+ * ToolClock::to_steady() before they are interpreted as times or durations.
+ */
+class ToolClock {
+private:
+  static inline bool s_use_tsc = false;
+  static inline bool s_use_rdtscp = false;
+  // calibration samples, taken at initialization and at finalization
+  static inline uint64_t s_tsc_begin = 0;
+  static inline int64_t s_steady_begin = 0;
+  // steady_clock nanoseconds per TSC tick as a 32.32 fixed point number
+  static inline uint64_t s_ns_per_tick = 0;
+
+  static uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (s_use_rdtscp) {
+      unsigned int aux;
+      return __rdtscp(&aux);
+    }
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+public:
+  /* Selects the timestamp source and takes the first calibration sample. If
+   * 'use_tsc' is true but the processor does not have an invariant TSC, a
+   * warning is printed and steady_clock is used instead.
+   */
+  static void init(bool use_tsc);
+
+  /* Takes the second calibration sample. Must be called once all events have
+   * been recorded and before any raw timestamp is converted.
+   */
+  static void calibrate();
+
+  /* Returns true if raw timestamps are TSC ticks.
+   */
+  static bool uses_tsc() { return s_use_tsc; }
+
+  /* Returns the current raw timestamp.
+   */
+  static std::chrono::steady_clock::time_point now() {
+    if (s_use_tsc) {
+      return std::chrono::steady_clock::time_point(
+          std::chrono::steady_clock::duration(read_tsc()));
+    }
+    return std::chrono::steady_clock::now();
+  }
+
+  /* Converts a raw timestamp to a steady_clock time point.
+   */
+  static std::chrono::steady_clock::time_point
+  to_steady(std::chrono::steady_clock::time_point raw) {
+    if (!s_use_tsc) {
+      return raw;
+    }
+    __extension__ typedef unsigned __int128 uint128_t;
+    const uint64_t ticks = raw.time_since_epoch().count() - s_tsc_begin;
+    const int64_t ns = (static_cast<uint128_t>(ticks) * s_ns_per_tick) >> 32;
+    return std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(s_steady_begin + ns));
+  }
+
+  /* Converts the difference of two raw timestamps to nanoseconds.
+   */
+  static std::chrono::duration<uint64_t, std::nano>
+  to_steady(std::chrono::duration<uint64_t, std::nano> raw) {
+    if (!s_use_tsc) {
+      return raw;
+    }
+    __extension__ typedef unsigned __int128 uint128_t;
+    return std::chrono::duration<uint64_t, std::nano>(
+        (static_cast<uint128_t>(raw.count()) * s_ns_per_tick) >> 32);
+  }
+};
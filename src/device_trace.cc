@@ -0,0 +1,183 @@
+#include "device_trace.hh"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <mutex>
+
+#include "arena.hh"
+#include "thread_log.hh"
+
+using namespace std::chrono;
+
+namespace {
+constexpr size_t k_trace_buffer_bytes = 1024 * 1024;
+// devices with a larger device_num are not traced
+constexpr int k_max_traced_devices = 64;
+
+/* Tracing entry points of a device, looked up when it is initialized. They do
+ * not change while the device is traced.
+ */
+typedef struct traced_device {
+  ompt_device_t *device;
+  ompt_flush_trace_t flush_trace; // optional
+  ompt_stop_trace_t stop_trace;
+  ompt_advance_buffer_cursor_t advance_buffer_cursor;
+  ompt_get_record_ompt_t get_record_ompt;
+  ompt_translate_time_t translate_time; // optional
+  bool tracing;
+} traced_device_t;
+
+std::array<traced_device_t, k_max_traced_devices> s_devices = {};
+std::mutex s_devices_mutex;
+
+// buffers handed back by the runtime, reused for the next requests and linked
+// through their first bytes
+void *s_free_buffers = nullptr;
+std::mutex s_free_buffers_mutex;
+
+/* Returns the nanoseconds between the device times 'start' and 'end'.
+ */
+uint64_t device_duration_ns(const traced_device_t &d, ompt_device_time_t start,
+                            ompt_device_time_t end) {
+  if (d.translate_time != nullptr) {
+    const double seconds =
+        d.translate_time(d.device, end) - d.translate_time(d.device, start);
+    return seconds > 0 ? std::llround(seconds * 1e9) : 0;
+  }
+  // without a translation, device times are taken to be nanoseconds, as they
+  // are in LLVM's offloading runtime
+  return end > start ? end - start : 0;
+}
+
+void on_buffer_request(int /*device_num*/, ompt_buffer_t **buffer,
+                       size_t *bytes) {
+  {
+    std::lock_guard<std::mutex> lock(s_free_buffers_mutex);
+    if (s_free_buffers != nullptr) {
+      *buffer = s_free_buffers;
+      s_free_buffers = *static_cast<void **>(s_free_buffers);
+      *bytes = k_trace_buffer_bytes;
+      return;
+    }
+  }
+  *buffer = arena_alloc(k_trace_buffer_bytes, alignof(std::max_align_t));
+  // without a buffer the runtime drops the records
+  *bytes = *buffer != nullptr ? k_trace_buffer_bytes : 0;
+  return;
+}
+
+void on_buffer_complete(int device_num, ompt_buffer_t *buffer, size_t bytes,
+                        ompt_buffer_cursor_t begin, int buffer_owned) {
+  if (device_num >= 0 && device_num < k_max_traced_devices && bytes > 0) {
+    const traced_device_t &d = s_devices[device_num];
+    thread_log_t *log = get_thread_log();
+    ompt_buffer_cursor_t cursor = begin;
+    while (true) {
+      const ompt_record_ompt_t *record = d.get_record_ompt(buffer, cursor);
+      if (record == nullptr) {
+        break;
+      }
+      if (record->type == ompt_callback_target_submit ||
+          record->type == ompt_callback_target_submit_emi) {
+        const ompt_record_target_kernel_t &kernel =
+            record->record.target_kernel;
+        const uint64_t exec_ns =
+            device_duration_ns(d, record->time, kernel.end_time);
+        // a kernel whose record is not logged keeps its submit span
+        if (kernel.host_op_id != 0 && exec_ns > 0) {
+          log->kernel_exec_log.emplace_back(
+              kernel.host_op_id, duration<uint64_t, std::nano>(exec_ns));
+        }
+      }
+      if (d.advance_buffer_cursor(d.device, buffer, bytes, cursor,
+                                  &cursor) == 0) {
+        break;
+      }
+    }
+  }
+  if (buffer_owned) {
+    std::lock_guard<std::mutex> lock(s_free_buffers_mutex);
+    *static_cast<void **>(buffer) = s_free_buffers;
+    s_free_buffers = buffer;
+  }
+  return;
+}
+
+/* Returns true if 'result' says the event is traced, at least sometimes.
+ */
+bool traced(ompt_set_result_t result) {
+  return result == ompt_set_sometimes || result == ompt_set_sometimes_paired ||
+         result == ompt_set_always;
+}
+} // namespace
+
+bool device_trace_start(int device_num, ompt_device_t *device,
+                        ompt_function_lookup_t lookup) {
+  if (device_num < 0 || device_num >= k_max_traced_devices ||
+      device == nullptr || lookup == nullptr) {
+    return false;
+  }
+  const auto set_trace_ompt =
+      reinterpret_cast<ompt_set_trace_ompt_t>(lookup("ompt_set_trace_ompt"));
+  const auto start_trace =
+      reinterpret_cast<ompt_start_trace_t>(lookup("ompt_start_trace"));
+  traced_device_t d = {};
+  d.device = device;
+  d.flush_trace =
+      reinterpret_cast<ompt_flush_trace_t>(lookup("ompt_flush_trace"));
+  d.stop_trace = reinterpret_cast<ompt_stop_trace_t>(lookup("ompt_stop_trace"));
+  d.advance_buffer_cursor = reinterpret_cast<ompt_advance_buffer_cursor_t>(
+      lookup("ompt_advance_buffer_cursor"));
+  d.get_record_ompt =
+      reinterpret_cast<ompt_get_record_ompt_t>(lookup("ompt_get_record_ompt"));
+  d.translate_time =
+      reinterpret_cast<ompt_translate_time_t>(lookup("ompt_translate_time"));
+  if (set_trace_ompt == nullptr || start_trace == nullptr ||
+      d.stop_trace == nullptr || d.advance_buffer_cursor == nullptr ||
+      d.get_record_ompt == nullptr) {
+    return false;
+  }
+  // only kernel records are needed, in whichever flavor the device traces
+  if (!traced(set_trace_ompt(device, 1, ompt_callback_target_submit_emi)) &&
+      !traced(set_trace_ompt(device, 1, ompt_callback_target_submit))) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(s_devices_mutex);
+  // buffers may complete as soon as tracing starts
+  s_devices[device_num] = d;
+  if (start_trace(device, on_buffer_request, on_buffer_complete) == 0) {
+    return false;
+  }
+  s_devices[device_num].tracing = true;
+  return true;
+}
+
+void device_trace_stop(int device_num) {
+  if (device_num < 0 || device_num >= k_max_traced_devices) {
+    return;
+  }
+  traced_device_t d;
+  {
+    std::lock_guard<std::mutex> lock(s_devices_mutex);
+    if (!s_devices[device_num].tracing) {
+      return;
+    }
+    s_devices[device_num].tracing = false;
+    d = s_devices[device_num];
+  }
+  if (d.flush_trace != nullptr) {
+    d.flush_trace(d.device);
+  }
+  d.stop_trace(d.device);
+  return;
+}
+
+void device_trace_stop_all() {
+  for (int device_num = 0; device_num < k_max_traced_devices; ++device_num) {
+    device_trace_stop(device_num);
+  }
+  return;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <omp-tools.h>
+
+/* Execution time of kernels measured on the devices through OMPT device
+ * tracing. When a device is initialized, it is asked to trace kernel
+ * submissions (see ompt_set_trace_ompt()) into buffers the tool hands to the
+ * runtime. The kernel records of each buffer the runtime completes are logged
+ * in the thread log of the thread it is delivered on, and carry the host_op_id
+ * the tool gave the submission in its submit callback, which matches them to
+ * their kernel_info_t when the logs are merged.
+ *
+ * Devices whose runtime does not support tracing, and kernels whose record
+ * could not be logged, keep only the span of their submit events, which
+ * depending on the runtime covers the kernel launch alone or its whole
+ * execution.
+ */
+
+/* Starts tracing the kernels of 'device', looking its tracing entry points up
+ * with 'lookup'. Returns false if the device cannot trace them.
+ */
+bool device_trace_start(int device_num, ompt_device_t *device,
+                        ompt_function_lookup_t lookup);
+
+/* Stops tracing device 'device_num', if it was traced, once its remaining
+ * records are delivered.
+ */
+void device_trace_stop(int device_num);
+
+/* Stops tracing every device still traced. Must be called before the thread
+ * logs are merged.
+ */
+void device_trace_stop_all();
@@ -0,0 +1,550 @@
+#include "hash.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include "hash_crc.hh"
+#include "hasher.hh"
+
+#ifndef OMPDATAPERF_BUILTIN_HASHES_ONLY
+#include <city.h>
+#include <citycrc.h>
+#include <farmhash.h>
+#include <rapidhash.h>
+#include <t1ha.h>
+#include <xxh_x86dispatch.h>
+#include <xxhash.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace {
+HASH_T make_hash(uint64_t low64, uint64_t high64 = 0) {
+  return HASH_T{low64, high64};
+}
+
+// seed of the hash functions that verify fingerprints, anything but the seed
+// of 0 used for fingerprints
+constexpr uint64_t k_verify_seed = UINT64_C(0x9e3779b97f4a7c15);
+
+#ifndef OMPDATAPERF_BUILTIN_HASHES_ONLY
+
+HASH_T city32(const void *data, size_t bytes) {
+  return make_hash(CityHash32(static_cast<const char *>(data), bytes));
+}
+
+HASH_T city64(const void *data, size_t bytes) {
+  return make_hash(CityHash64(static_cast<const char *>(data), bytes));
+}
+
+HASH_T city128(const void *data, size_t bytes) {
+  const uint128 hash = CityHash128(static_cast<const char *>(data), bytes);
+  return make_hash(Uint128Low64(hash), Uint128High64(hash));
+}
+
+HASH_T city_crc128(const void *data, size_t bytes) {
+  const uint128 hash = CityHashCrc128(static_cast<const char *>(data), bytes);
+  return make_hash(Uint128Low64(hash), Uint128High64(hash));
+}
+
+HASH_T farm32(const void *data, size_t bytes) {
+  return make_hash(util::Hash32(static_cast<const char *>(data), bytes));
+}
+
+HASH_T farm64(const void *data, size_t bytes) {
+  return make_hash(util::Hash64(static_cast<const char *>(data), bytes));
+}
+
+HASH_T farm128(const void *data, size_t bytes) {
+  const util::uint128_t hash =
+      util::Hash128(static_cast<const char *>(data), bytes);
+  return make_hash(util::Uint128Low64(hash), util::Uint128High64(hash));
+}
+
+HASH_T rapid64(const void *data, size_t bytes) {
+  return make_hash(rapidhash(data, bytes));
+}
+
+HASH_T t1ha0_aes_avx2(const void *data, size_t bytes) {
+  return make_hash(t1ha0_ia32aes_avx2(data, bytes, 0));
+}
+
+HASH_T t1ha0_aes_avx(const void *data, size_t bytes) {
+  return make_hash(t1ha0_ia32aes_avx(data, bytes, 0));
+}
+
+HASH_T t1ha0_aes_noavx(const void *data, size_t bytes) {
+  return make_hash(t1ha0_ia32aes_noavx(data, bytes, 0));
+}
+
+HASH_T t1ha0_le(const void *data, size_t bytes) {
+  return make_hash(t1ha0_32le(data, bytes, 0));
+}
+
+HASH_T t1ha0_be(const void *data, size_t bytes) {
+  return make_hash(t1ha0_32be(data, bytes, 0));
+}
+
+HASH_T t1ha1_le64(const void *data, size_t bytes) {
+  return make_hash(t1ha1_le(data, bytes, 0));
+}
+
+HASH_T t1ha1_be64(const void *data, size_t bytes) {
+  return make_hash(t1ha1_be(data, bytes, 0));
+}
+
+HASH_T t1ha2_64(const void *data, size_t bytes) {
+  return make_hash(t1ha2_atonce(data, bytes, 0));
+}
+
+HASH_T t1ha2_128(const void *data, size_t bytes) {
+  uint64_t high64;
+  const uint64_t low64 = t1ha2_atonce128(&high64, data, bytes, 0);
+  return make_hash(low64, high64);
+}
+
+HASH_T xxh32(const void *data, size_t bytes) {
+  return make_hash(XXH32(data, bytes, 0));
+}
+
+HASH_T xxh64(const void *data, size_t bytes) {
+  return make_hash(XXH64(data, bytes, 0));
+}
+
+// XXH3 picks its own SSE2, AVX2 or AVX-512 implementation at runtime
+HASH_T xxh3_64(const void *data, size_t bytes) {
+  return make_hash(XXH3_64bits_dispatch(data, bytes));
+}
+
+HASH_T xxh3_128(const void *data, size_t bytes) {
+  const XXH128_hash_t hash = XXH3_128bits_dispatch(data, bytes);
+  return make_hash(hash.low64, hash.high64);
+}
+
+HASH_T t1ha2_128_verify(const void *data, size_t bytes) {
+  uint64_t high64;
+  const uint64_t low64 = t1ha2_atonce128(&high64, data, bytes, k_verify_seed);
+  return make_hash(low64, high64);
+}
+
+HASH_T xxh3_128_verify(const void *data, size_t bytes) {
+  const XXH128_hash_t hash =
+      XXH3_128bits_withSeed_dispatch(data, bytes, k_verify_seed);
+  return make_hash(hash.low64, hash.high64);
+}
+#else
+uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= UINT64_C(0xff51afd7ed558ccd);
+  k ^= k >> 33;
+  k *= UINT64_C(0xc4ceb9fe1a85ec53);
+  k ^= k >> 33;
+  return k;
+}
+
+/* MurmurHash3_x64_128, verifies fingerprints when the hash functions of
+ * hashes/ are not built, as CRC32C_x8 cannot verify itself: its collisions do
+ * not depend on the seed.
+ */
+HASH_T murmur3_128_verify(const void *data, size_t bytes) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  constexpr uint64_t c1 = UINT64_C(0x87c37b91114253d5);
+  constexpr uint64_t c2 = UINT64_C(0x4cf5ad432745937f);
+  uint64_t h1 = k_verify_seed;
+  uint64_t h2 = k_verify_seed;
+  size_t offset = 0;
+  for (; bytes - offset >= 16; offset += 16) {
+    uint64_t k1, k2;
+    memcpy(&k1, p + offset, sizeof(k1));
+    memcpy(&k2, p + offset + 8, sizeof(k2));
+    h1 ^= rotl64(k1 * c1, 31) * c2;
+    h1 = (rotl64(h1, 27) + h2) * 5 + 0x52dce729;
+    h2 ^= rotl64(k2 * c2, 33) * c1;
+    h2 = (rotl64(h2, 31) + h1) * 5 + 0x38495ab5;
+  }
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  for (size_t i = bytes - offset; i > 8; --i) {
+    k2 = (k2 << 8) | p[offset + i - 1];
+  }
+  for (size_t i = std::min<size_t>(bytes - offset, 8); i > 0; --i) {
+    k1 = (k1 << 8) | p[offset + i - 1];
+  }
+  if (bytes - offset > 8) {
+    h2 ^= rotl64(k2 * c2, 33) * c1;
+  }
+  if (bytes - offset > 0) {
+    h1 ^= rotl64(k1 * c1, 31) * c2;
+  }
+  h1 ^= bytes;
+  h2 ^= bytes;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+  return make_hash(h1, h2);
+}
+#endif
+} // namespace
+
+#ifndef OMPDATAPERF_BUILTIN_HASHES_ONLY
+// defined in hash_meow.cc, which is the only file built with AES-NI enabled
+HASH_T meow128(const void *data, size_t bytes);
+#endif
+
+namespace {
+constexpr uint32_t k_crc_avx2_features =
+    k_cpu_sse42 | k_cpu_avx2 | k_cpu_vpclmul;
+constexpr uint32_t k_crc_avx512_features =
+    k_cpu_sse42 | k_cpu_avx512 | k_cpu_vpclmul;
+
+// clang-format off
+const std::vector<hash_backend_t> k_hash_backends = {
+  {"CRC32C_x8",           128, 0,                       crc32c_x8},
+  {"CRC32C_x8_sse42",     128, k_cpu_sse42,             crc32c_x8_sse42},
+  {"CRC32C_x8_avx2",      128, k_crc_avx2_features,     crc32c_x8_avx2},
+  {"CRC32C_x8_avx512",    128, k_crc_avx512_features,   crc32c_x8_avx512},
+#ifndef OMPDATAPERF_BUILTIN_HASHES_ONLY
+  {"CityHash32",          32,  k_cpu_sse42,             city32},
+  {"CityHash64",          64,  k_cpu_sse42,             city64},
+  {"CityHash128",         128, k_cpu_sse42,             city128},
+  {"CityHashCrc128",      128, k_cpu_sse42,             city_crc128},
+  {"FarmHash32",          32,  0,                       farm32},
+  {"FarmHash64",          64,  0,                       farm64},
+  {"FarmHash128",         128, 0,                       farm128},
+  {"MeowHash",            128, k_cpu_sse42 | k_cpu_aes, meow128},
+  {"rapidhash",           64,  0,                       rapid64},
+  {"t1ha0_ia32aes_avx",   64,  k_cpu_aes | k_cpu_avx,   t1ha0_aes_avx},
+  {"t1ha0_ia32aes_avx2",  64,  k_cpu_aes | k_cpu_avx2,  t1ha0_aes_avx2},
+  {"t1ha0_ia32aes_noavx", 64,  k_cpu_aes,               t1ha0_aes_noavx},
+  {"t1ha0_32le",          32,  0,                       t1ha0_le},
+  {"t1ha0_32be",          32,  0,                       t1ha0_be},
+  {"t1ha1_le",            64,  0,                       t1ha1_le64},
+  {"t1ha1_be",            64,  0,                       t1ha1_be64},
+  {"t1ha2_atonce",        64,  0,                       t1ha2_64},
+  {"t1ha2_atonce128",     128, 0,                       t1ha2_128},
+  {"XXH32",               32,  0,                       xxh32},
+  {"XXH64",               64,  0,                       xxh64},
+  {"XXH3_64bits",         64,  0,                       xxh3_64},
+  {"XXH3_128bits",        128, 0,                       xxh3_128},
+#endif
+};
+
+/* Hash functions picked by default, fastest first, along with the features
+ * they need to be the fastest. The last entry needs nothing.
+ */
+const std::pair<const char *, uint32_t> k_hash_preference[] = {
+#ifndef OMPDATAPERF_BUILTIN_HASHES_ONLY
+  {"XXH3_64bits",         k_cpu_avx512},
+  {"t1ha0_ia32aes_avx2",  k_cpu_aes | k_cpu_avx2},
+  {"t1ha0_ia32aes_avx",   k_cpu_aes | k_cpu_avx},
+  {"t1ha0_ia32aes_noavx", k_cpu_aes},
+  {"XXH3_64bits",         0},
+#else
+  {"CRC32C_x8_avx512",    k_crc_avx512_features},
+  {"CRC32C_x8_avx2",      k_crc_avx2_features},
+  {"CRC32C_x8_sse42",     k_cpu_sse42},
+  {"CRC32C_x8",           0},
+#endif
+};
+
+/* Hash functions that verify fingerprints. XXH3 verifies every function but
+ * the XXH family, which t1ha2 verifies.
+ */
+#ifndef OMPDATAPERF_BUILTIN_HASHES_ONLY
+const hash_backend_t k_verify_backend = {
+  "XXH3_128bits (seeded)",    128, 0, xxh3_128_verify};
+const hash_backend_t k_verify_backend_xxh = {
+  "t1ha2_atonce128 (seeded)", 128, 0, t1ha2_128_verify};
+#else
+const hash_backend_t k_verify_backend = {
+  "MurmurHash3_x64_128 (seeded)", 128, 0, murmur3_128_verify};
+const hash_backend_t k_verify_backend_xxh = k_verify_backend;
+#endif
+// clang-format on
+
+const hash_backend_t *s_hash_backend = nullptr;
+const hash_backend_t *s_verify_backend = nullptr;
+
+const hash_backend_t *find_hash_backend(const char *name) {
+  for (const hash_backend_t &backend : k_hash_backends) {
+    if (strcmp(backend.name, name) == 0) {
+      return &backend;
+    }
+  }
+  return nullptr;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* Returns the state components the operating system saves on context
+ * switches, see the XGETBV instruction.
+ */
+uint64_t get_xcr0() {
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+#endif
+} // namespace
+
+uint32_t get_cpu_features() {
+  uint32_t features = 0;
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+    return features;
+  }
+  if (ecx & bit_SSE4_2) {
+    features |= k_cpu_sse42;
+  }
+  if (ecx & bit_AES) {
+    features |= k_cpu_aes;
+  }
+  // the AVX registers are only usable if the operating system saves them
+  const bool has_xsave = (ecx & bit_OSXSAVE) != 0;
+  const uint64_t xcr0 = has_xsave ? get_xcr0() : 0;
+  const bool os_avx = (xcr0 & 0x6) == 0x6;      // SSE and AVX state
+  const bool os_avx512 = (xcr0 & 0xe6) == 0xe6; // and opmask, ZMM state
+  if (os_avx && (ecx & bit_AVX)) {
+    features |= k_cpu_avx;
+  }
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0) {
+    return features;
+  }
+  if (os_avx && (features & k_cpu_avx) && (ebx & bit_AVX2)) {
+    features |= k_cpu_avx2;
+  }
+  if (os_avx512 && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW)) {
+    features |= k_cpu_avx512;
+  }
+  if (os_avx && (features & k_cpu_aes) && (ecx & bit_VAES)) {
+    features |= k_cpu_vaes;
+  }
+  if (os_avx && (ecx & bit_VPCLMULQDQ)) {
+    features |= k_cpu_vpclmul;
+  }
+#endif
+  return features;
+}
+
+const std::vector<hash_backend_t> &get_hash_backends() {
+  return k_hash_backends;
+}
+
+namespace {
+/* Returns the hash function named 'name', or the fastest one the processor
+ * supports (see hash_init()).
+ */
+const hash_backend_t *select_hash_backend(const char *name) {
+  const uint32_t features = get_cpu_features();
+  const hash_backend_t *fastest = nullptr;
+  for (const auto &[preferred, needed] : k_hash_preference) {
+    const hash_backend_t *backend = find_hash_backend(preferred);
+    if ((needed & features) == needed &&
+        (backend->required_features & features) ==
+            backend->required_features) {
+      fastest = backend;
+      break;
+    }
+  }
+  if (name == nullptr || name[0] == '\0') {
+    return fastest;
+  }
+  const hash_backend_t *backend = find_hash_backend(name);
+  if (backend == nullptr) {
+    std::cerr << "warning: unknown hash function '" << name << "'. Using "
+              << fastest->name << " instead.\n";
+  } else if ((backend->required_features & features) !=
+             backend->required_features) {
+    std::cerr << "warning: hash function '" << name
+              << "' is not supported by this processor. Using "
+              << fastest->name << " instead.\n";
+  } else {
+    return backend;
+  }
+  return fastest;
+}
+
+// sizes the hash functions are timed at by the autotuner while they are in
+// the caches: a small transfer, a page and a leaf of a large transfer (see
+// hasher.hh)
+constexpr size_t k_autotune_sizes[] = {256, 4096, 64 * 1024};
+// each size is hashed repeatedly for this long, k_autotune_runs times, and
+// the fastest run is kept
+constexpr std::chrono::microseconds k_autotune_run_time(100);
+constexpr int k_autotune_runs = 7;
+// The fastest functions on cached data, at most k_autotune_cold_candidates of
+// them and none less than half as fast as the fastest, are also timed hashing
+// a buffer larger than the L2 cache leaf by leaf, the way large transfers are
+// streamed, since memory bandwidth evens out their differences. Each one
+// hashes it k_autotune_cold_runs times and the fastest run is kept.
+constexpr size_t k_autotune_cold_bytes = 8 * 1024 * 1024;
+constexpr size_t k_autotune_cold_candidates = 3;
+constexpr int k_autotune_cold_runs = 3;
+
+volatile uint64_t s_autotune_sink;
+
+/* Returns the throughput in bytes per second of 'backend' hashing the first
+ * 'bytes' bytes of 'data', which stay in the caches.
+ */
+double time_hash_backend(const hash_backend_t &backend,
+                         const unsigned char *data, size_t bytes) {
+  using std::chrono::steady_clock;
+  // some functions set themselves up when they are first called
+  uint64_t sink = backend.fn(data, bytes).low64;
+  double best = 0.0;
+  for (int run = 0; run < k_autotune_runs; ++run) {
+    size_t calls = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    steady_clock::duration elapsed;
+    do {
+      for (int i = 0; i < 8; ++i) {
+        sink += backend.fn(data, bytes).low64;
+      }
+      calls += 8;
+      elapsed = steady_clock::now() - start;
+    } while (elapsed < k_autotune_run_time);
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    best = std::max(best, calls * bytes / seconds);
+  }
+  s_autotune_sink = sink;
+  return best;
+}
+
+/* Returns the throughput in bytes per second of 'backend' streaming the
+ * k_autotune_cold_bytes bytes of 'data' leaf by leaf.
+ */
+double time_hash_backend_cold(const hash_backend_t &backend,
+                              const unsigned char *data) {
+  using std::chrono::steady_clock;
+  uint64_t sink = 0;
+  double best = 0.0;
+  for (int run = 0; run < k_autotune_cold_runs; ++run) {
+    const steady_clock::time_point start = steady_clock::now();
+    for (size_t offset = 0; offset < k_autotune_cold_bytes;
+         offset += k_hash_leaf_bytes) {
+      sink += hash_streaming_with(backend.fn, data + offset,
+                                  k_hash_leaf_bytes)
+                  .low64;
+    }
+    const double seconds =
+        std::chrono::duration<double>(steady_clock::now() - start).count();
+    best = std::max(best, k_autotune_cold_bytes / seconds);
+  }
+  s_autotune_sink = sink;
+  return best;
+}
+
+/* Returns the supported hash function at least 'min_bits' wide with the
+ * highest geometric mean throughput over k_autotune_sizes and cold data, or
+ * nullptr if there is none.
+ */
+const hash_backend_t *autotune_hash_backend(unsigned int min_bits) {
+  static_assert(k_autotune_cold_bytes % k_hash_leaf_bytes == 0);
+  const auto start = std::chrono::steady_clock::now();
+  // arbitrary data, some functions have shortcuts for zeros
+  auto data = std::make_unique<uint64_t[]>(k_autotune_cold_bytes /
+                                           sizeof(uint64_t));
+  uint64_t state = UINT64_C(0x9e3779b97f4a7c15);
+  for (size_t i = 0; i < k_autotune_cold_bytes / sizeof(uint64_t); ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    data[i] = state;
+  }
+  const unsigned char *bytes_data =
+      reinterpret_cast<const unsigned char *>(data.get());
+
+  // geometric mean throughput of each supported function on cached data
+  const uint32_t features = get_cpu_features();
+  std::vector<std::pair<double, const hash_backend_t *>> hot;
+  for (const hash_backend_t &backend : k_hash_backends) {
+    if (backend.bits < min_bits || (backend.required_features & features) !=
+                                       backend.required_features) {
+      continue;
+    }
+    double log_sum = 0.0;
+    for (const size_t bytes : k_autotune_sizes) {
+      log_sum += std::log(time_hash_backend(backend, bytes_data, bytes));
+    }
+    hot.emplace_back(log_sum, &backend);
+  }
+  std::sort(hot.begin(), hot.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+  if (hot.size() > k_autotune_cold_candidates) {
+    hot.resize(k_autotune_cold_candidates);
+  }
+  const double min_log_sum =
+      hot.empty() ? 0.0
+                  : hot.front().first -
+                        std::size(k_autotune_sizes) * std::log(2.0);
+  std::erase_if(hot, [min_log_sum](const auto &candidate) {
+    return candidate.first < min_log_sum;
+  });
+
+  const hash_backend_t *best = nullptr;
+  double best_throughput = 0.0;
+  for (const auto &[log_sum, backend] : hot) {
+    const double cold_log =
+        std::log(time_hash_backend_cold(*backend, bytes_data));
+    const double throughput =
+        std::exp((log_sum + cold_log) / (std::size(k_autotune_sizes) + 1));
+    if (throughput > best_throughput) {
+      best = backend;
+      best_throughput = throughput;
+    }
+  }
+
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (best == nullptr) {
+    std::cerr << "warning: no hash function is at least " << min_bits
+              << " bits wide. Using the default.\n";
+  } else {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1) << best_throughput / 1e9
+        << " GB/s, picked in " << elapsed.count() << " ms";
+    std::cerr << "info: autotuned hash function: " << best->name << " ("
+              << oss.str() << ")\n";
+  }
+  return best;
+}
+} // namespace
+
+void hash_init(const char *name, unsigned int auto_min_bits) {
+  if (name != nullptr && strcmp(name, "auto") == 0) {
+    s_hash_backend = autotune_hash_backend(auto_min_bits);
+    if (s_hash_backend == nullptr) {
+      s_hash_backend = select_hash_backend(nullptr);
+    }
+  } else {
+    s_hash_backend = select_hash_backend(name);
+  }
+  if (strncmp(s_hash_backend->name, "XXH", 3) == 0) {
+    s_verify_backend = &k_verify_backend_xxh;
+  } else {
+    s_verify_backend = &k_verify_backend;
+  }
+  return;
+}
+
+const hash_backend_t &get_hash_backend() { return *s_hash_backend; }
+
+HASH_T hash_bytes(const void *data, size_t bytes) {
+  return s_hash_backend->fn(data, bytes);
+}
+
+const hash_backend_t &get_verify_hash_backend() { return *s_verify_backend; }
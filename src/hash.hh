@@ -1,125 +1,87 @@
 #pragma once
 
-#include <cstdint>
 #include <compare>
-template <typename Traits>
-class HashType128 {
-private:
-    using HashValue = typename Traits::HashType;
-    HashValue val;
-public:
-    HashType128() : val() {}
-    HashType128(HashValue val) : val(val) {}
-    std::strong_ordering operator<=>(const HashType128& other) const {
-        uint64_t a1 = Traits::high64(val);
-        uint64_t b1 = Traits::high64(other.val);
-        if (a1 < b1) return std::strong_ordering::less;
-        if (a1 > b1) return std::strong_ordering::greater;
-        uint64_t a0 = Traits::low64(val);
-        uint64_t b0 = Traits::low64(other.val);
-        if (a0 < b0) return std::strong_ordering::less;
-        if (a0 > b0) return std::strong_ordering::greater;
-        return std::strong_ordering::equal;
-    }
-    bool operator==(const HashType128& other) const {
-        return Traits::isEqual(val, other.val);
-    }
-};
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Every hash function bundled in hashes/ is compiled into the tool, along with
+ * the built-in CRC32C_x8 engine (see hash_crc.hh), which is the only one left
+ * when the hashes/ submodules are not checked out. One of them is picked at
+ * startup, by default the fastest one the processor supports. Hashes are
+ * stored as 128 bit fingerprints whatever the width of the function that
+ * produced them, narrower hashes are zero extended, so that the event logs,
+ * traces and analyses do not depend on the choice.
+ */
+typedef struct fingerprint {
+  uint64_t low64;
+  uint64_t high64;
 
-#if defined(HASH_FUNCTION_CityHash32)     || \
-    defined(HASH_FUNCTION_CityHash64)     || \
-    defined(HASH_FUNCTION_CityHash128)    || \
-    defined(HASH_FUNCTION_CityHashCrc128)
-  #include <city.h>
-  #include <citycrc.h>
-  #define HASH_FN(key, len) HASH_FUNCTION((const char *) key, len)
-  #if defined(HASH_FUNCTION_CityHash32)
-    #define HASH_T uint32
-  #elif defined(HASH_FUNCTION_CityHash64)
-    #define HASH_T uint64
-  #elif defined(HASH_FUNCTION_CityHash128) || \
-        defined(HASH_FUNCTION_CityHashCrc128)
-    #define HASH_T uint128
-  #endif
+  auto operator<=>(const fingerprint &other) const = default;
+} fingerprint_t;
+
+typedef fingerprint_t HASH_T;
+
+/* Returns 32 well mixed bits of 'hash' and 'salt', to shard or sample by
+ * fingerprint. Narrow hashes leave the high bits of the fingerprint zero and
+ * inline payloads are not uniformly distributed, so neither half can be used
+ * as is.
+ */
+inline uint32_t fingerprint_mix(const HASH_T &hash, uint64_t salt = 0) {
+  return ((hash.low64 ^ hash.high64 ^ salt) * UINT64_C(0x9e3779b97f4a7c15)) >>
+         32;
+}
+
+/* Processor features a hash function may depend on.
+ */
+enum cpu_feature : uint32_t {
+  k_cpu_sse42 = 1u << 0,
+  k_cpu_aes = 1u << 1,
+  k_cpu_avx = 1u << 2,
+  k_cpu_avx2 = 1u << 3,
+  k_cpu_avx512 = 1u << 4,  // AVX-512 foundation and byte/word instructions
+  k_cpu_vaes = 1u << 5,    // AES-NI on AVX2/AVX-512 registers
+  k_cpu_vpclmul = 1u << 6, // carry-less multiply on AVX2/AVX-512 registers
+};
 
-#elif defined(HASH_FUNCTION_FarmHash32) || \
-    defined(HASH_FUNCTION_FarmHash64)   || \
-    defined(HASH_FUNCTION_FarmHash128)
-  #include <farmhash.h>
-  #if defined(HASH_FUNCTION_FarmHash32)
-    #define HASH_T uint32_t
-    #define HASH_FN(key, len) util::Hash32((const char *) key, len)
-  #elif defined(HASH_FUNCTION_FarmHash64)
-    #define HASH_T uint64_t
-    #define HASH_FN(key, len) util::Hash64((const char *) key, len)
-  #elif defined(HASH_FUNCTION_FarmHash128)
-    #define HASH_T util::uint128_t
-    #define HASH_FN(key, len) util::Hash128((const char *) key, len)
-  #endif
+typedef struct hash_backend {
+  const char *name;
+  unsigned int bits;          // width of the hashes it produces
+  uint32_t required_features; // cpu_feature flags it cannot run without
+  HASH_T (*fn)(const void *data, size_t bytes);
+} hash_backend_t;
 
-#elif defined(HASH_FUNCTION_MeowHash)
-  #include <meow_hash_x64_aesni.h>
-  struct MeowHashTraits {
-    using HashType = meow_u128;
-    static uint64_t high64(const HashType& val) { return MeowU64From(val, 1); }
-    static uint64_t low64(const HashType& val) { return MeowU64From(val, 0); }
-    static bool isEqual(const HashType& a, const HashType& b) {
-      return MeowHashesAreEqual(a, b);
-    }
-  };
-  #define HASH_T HashType128<MeowHashTraits>
-  #define HASH_FN(key, len) HASH_FUNCTION(MeowDefaultSeed, len, key)
+/* Returns the cpu_feature flags of the processor that are usable, i.e. also
+ * enabled by the operating system.
+ */
+uint32_t get_cpu_features();
 
-#elif defined(HASH_FUNCTION_rapidhash)
-  #include <rapidhash.h>
-  #define HASH_T uint64_t
-  #define HASH_FN(key, len) HASH_FUNCTION(key, len)
+/* Returns every hash function compiled into the tool.
+ */
+const std::vector<hash_backend_t> &get_hash_backends();
 
-#elif defined(HASH_FUNCTION_t1ha0_ia32aes_avx)   || \
-      defined(HASH_FUNCTION_t1ha0_ia32aes_avx2)  || \
-      defined(HASH_FUNCTION_t1ha0_ia32aes_noavx) || \
-      defined(HASH_FUNCTION_t1ha0_32le)          || \
-      defined(HASH_FUNCTION_t1ha0_32be)          || \
-      defined(HASH_FUNCTION_t1ha1_le)            || \
-      defined(HASH_FUNCTION_t1ha1_be)            || \
-      defined(HASH_FUNCTION_t1ha2_atonce)
-  #include <t1ha.h>
-  #define HASH_FN(key, len) HASH_FUNCTION(key, len, 0)
-  #if defined(HASH_FUNCTION_t1ha0_32le) || \
-      defined(HASH_FUNCTION_t1ha0_32le)
-    #define HASH_T uint32_t
-  #else
-    #define HASH_T uint64_t
-  #endif
+/* Selects the hash function named 'name', or the fastest one the processor
+ * supports if 'name' is nullptr or empty. If the named function does not
+ * exist or is not supported by the processor, the default is used instead and
+ * a warning naming it is printed. Must be called before anything is hashed.
+ *
+ * If 'name' is "auto", every supported function at least 'auto_min_bits'
+ * wide is timed on this machine, on cached buffers and for the fastest few
+ * also on a buffer streamed from memory, and the fastest one is selected,
+ * which takes a few tens of milliseconds.
+ */
+void hash_init(const char *name, unsigned int auto_min_bits);
 
-#elif defined(HASH_FUNCTION_XXH32)        || \
-      defined(HASH_FUNCTION_XXH64)        || \
-      defined(HASH_FUNCTION_XXH3_64bits)  || \
-      defined(HASH_FUNCTION_XXH3_128bits)
-  #include <xxhash.h>
-  #if defined(HASH_FUNCTION_XXH3_128bits)
-    struct XXHash128traits {
-      using HashType = XXH128_hash_t;
-      static uint64_t high64(const HashType& val) { return val.high64; }
-      static uint64_t low64(const HashType& val) { return val.low64; }
-      static bool isEqual(const HashType& a, const HashType& b) {
-        return XXH128_isEqual(a, b);
-      }
-    };
-    #define HASH_T HashType128<XXHash128traits>
-  #elif defined(HASH_FUNCTION_XXH32)
-    #define HASH_T uint32_t
-  #else
-    #define HASH_T uint64_t
-  #endif
+/* Returns the selected hash function.
+ */
+const hash_backend_t &get_hash_backend();
 
-  #if defined(HASH_FUNCTION_XXH32) || \
-      defined(HASH_FUNCTION_XXH64)
-    #define HASH_FN(key, len) HASH_FUNCTION(key, len, 0)
-  #else
-    #define HASH_FN(key, len) HASH_FUNCTION(key, len)
-  #endif
+/* Hashes 'bytes' bytes starting at 'data' with the selected hash function.
+ */
+HASH_T hash_bytes(const void *data, size_t bytes);
 
-#else
-  #error "invalid hash function"
-#endif
+/* Returns the hash function used to verify the fingerprints of the selected
+ * one. It belongs to another family of hash functions and uses another seed,
+ * so that its collisions are independent of those of the selected function.
+ */
+const hash_backend_t &get_verify_hash_backend();
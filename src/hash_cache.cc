@@ -0,0 +1,272 @@
+#include "hash_cache.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "hasher.hh"
+
+using namespace std::chrono;
+
+namespace {
+// maximum number of buffers cached at once, the whole cache is dropped when it
+// is exceeded
+constexpr size_t k_max_cached_buffers = 1024;
+// minimum time between two clears of the soft-dirty bits, clearing them is
+// costly and makes the application take page faults
+constexpr duration<int64_t, std::milli> k_min_clear_interval(10);
+
+// bits of a /proc/self/pagemap entry
+constexpr uint64_t k_pagemap_soft_dirty = 1ull << 55;
+constexpr uint64_t k_pagemap_swapped = 1ull << 62;
+constexpr uint64_t k_pagemap_present = 1ull << 63;
+
+/* Cached leaf hashes of one buffer.
+ */
+typedef struct cached_buffer {
+  std::unique_ptr<HASH_T[]> leaf_hashes;
+  // epoch during which each leaf hash was computed, 0 if it never was
+  std::unique_ptr<uint32_t[]> leaf_epochs;
+} cached_buffer_t;
+
+bool s_enabled = false;
+int s_pagemap_fd = -1;
+int s_clear_refs_fd = -1;
+size_t s_page_bytes = 4096;
+
+// everything below is protected by s_cache_mutex
+std::mutex s_cache_mutex;
+std::map<std::pair<uintptr_t /*addr*/, size_t /*bytes*/>, cached_buffer_t>
+    s_cache;
+uint32_t s_epoch = 1;
+steady_clock::time_point s_last_clear;
+
+/* Clears the soft-dirty bits of every page of the process.
+ */
+bool clear_soft_dirty() {
+  return pwrite(s_clear_refs_fd, "4", 1, 0) == 1;
+}
+
+/* Reads whether each page of the range has possibly been written since the
+ * soft-dirty bits were last cleared. Pages that are not present are reported
+ * as written since their contents may have been discarded.
+ */
+bool read_dirty_pages(uintptr_t addr, size_t bytes, std::vector<bool> &dirty) {
+  const uintptr_t first_page = addr / s_page_bytes;
+  const uintptr_t last_page = (addr + bytes - 1) / s_page_bytes;
+  const size_t num_pages = last_page - first_page + 1;
+  std::vector<uint64_t> entries(num_pages);
+  const size_t len = num_pages * sizeof(uint64_t);
+  size_t done = 0;
+  while (done < len) {
+    const ssize_t ret =
+        pread(s_pagemap_fd, reinterpret_cast<char *>(entries.data()) + done,
+              len - done, first_page * sizeof(uint64_t) + done);
+    if (ret <= 0) {
+      return false;
+    }
+    done += ret;
+  }
+
+  dirty.resize(num_pages);
+  for (size_t i = 0; i < num_pages; ++i) {
+    const uint64_t entry = entries[i];
+    const bool present = (entry & (k_pagemap_present | k_pagemap_swapped)) != 0;
+    dirty[i] = !present || (entry & k_pagemap_soft_dirty) != 0;
+  }
+  return true;
+}
+
+/* Returns true if none of the pages overlapping leaf 'leaf' of the buffer
+ * starting at 'addr' is dirty.
+ */
+bool is_leaf_clean(uintptr_t addr, size_t bytes, size_t leaf,
+                   const std::vector<bool> &dirty) {
+  const uintptr_t first_page = addr / s_page_bytes;
+  const uintptr_t start = addr + leaf * k_hash_leaf_bytes;
+  const uintptr_t end = std::min(start + k_hash_leaf_bytes, addr + bytes);
+  for (uintptr_t page = start / s_page_bytes; page <= (end - 1) / s_page_bytes;
+       ++page) {
+    if (dirty[page - first_page]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Carries the leaves that are still valid over into a new epoch and clears the
+ * soft-dirty bits. Must be called with s_cache_mutex held.
+ */
+void start_new_epoch() {
+  std::vector<bool> dirty;
+  for (auto &[key, entry] : s_cache) {
+    const auto [addr, bytes] = key;
+    const size_t num_leaves = hash_num_leaves(bytes);
+    if (!read_dirty_pages(addr, bytes, dirty)) {
+      std::fill_n(entry.leaf_epochs.get(), num_leaves, 0);
+      continue;
+    }
+    for (size_t leaf = 0; leaf < num_leaves; ++leaf) {
+      if (entry.leaf_epochs[leaf] == s_epoch &&
+          is_leaf_clean(addr, bytes, leaf, dirty)) {
+        entry.leaf_epochs[leaf] = s_epoch + 1;
+      }
+    }
+  }
+  if (!clear_soft_dirty()) {
+    // nothing carried over can be trusted any longer
+    s_cache.clear();
+  }
+  s_epoch += 1;
+  s_last_clear = steady_clock::now();
+  return;
+}
+
+/* Checks that soft-dirty bits are set when a page is written and cleared when
+ * requested.
+ */
+bool test_soft_dirty() {
+  void *page = mmap(nullptr, s_page_bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED) {
+    return false;
+  }
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(page);
+  std::vector<bool> dirty;
+  bool ok = true;
+  *static_cast<volatile char *>(page) = 1;
+  ok = ok && clear_soft_dirty();
+  ok = ok && read_dirty_pages(addr, 1, dirty) && !dirty[0];
+  *static_cast<volatile char *>(page) = 2;
+  ok = ok && read_dirty_pages(addr, 1, dirty) && dirty[0];
+  munmap(page, s_page_bytes);
+  return ok;
+}
+} // namespace
+
+bool hash_cache_init() {
+  s_page_bytes = sysconf(_SC_PAGESIZE);
+  s_pagemap_fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  s_clear_refs_fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  const bool opened = s_pagemap_fd >= 0 && s_clear_refs_fd >= 0;
+  if (!opened || !test_soft_dirty()) {
+    std::cerr << "warning: soft-dirty page tracking is not available, the "
+                 "hash cache is disabled.";
+    if (!opened) {
+      std::cerr << " " << strerror(errno);
+    }
+    std::cerr << "\n";
+    if (s_pagemap_fd >= 0) {
+      close(s_pagemap_fd);
+    }
+    if (s_clear_refs_fd >= 0) {
+      close(s_clear_refs_fd);
+    }
+    return false;
+  }
+  s_last_clear = steady_clock::now();
+  s_enabled = true;
+  return true;
+}
+
+bool hash_cache_enabled() { return s_enabled; }
+
+HASH_T hash_cache_hash(const void *data, size_t bytes) {
+  assert(s_enabled && bytes >= k_hash_cache_min_bytes);
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(data);
+  const size_t num_leaves = hash_num_leaves(bytes);
+  std::unique_ptr<HASH_T[]> leaf_hashes(new HASH_T[num_leaves]);
+  std::vector<size_t> stale_leaves;
+  uint32_t epoch;
+
+  {
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    epoch = s_epoch;
+    std::vector<bool> dirty;
+    if (!read_dirty_pages(addr, bytes, dirty)) {
+      // rehash every leaf, the hashes are then recorded as never computed
+      epoch = 0;
+    }
+    if (s_cache.size() >= k_max_cached_buffers) {
+      s_cache.clear();
+    }
+    auto [it, inserted] = s_cache.try_emplace({addr, bytes});
+    cached_buffer_t &entry = it->second;
+    if (inserted) {
+      entry.leaf_hashes.reset(new HASH_T[num_leaves]);
+      entry.leaf_epochs.reset(new uint32_t[num_leaves]());
+    }
+    for (size_t leaf = 0; leaf < num_leaves; ++leaf) {
+      if (epoch != 0 && entry.leaf_epochs[leaf] == epoch &&
+          is_leaf_clean(addr, bytes, leaf, dirty)) {
+        leaf_hashes[leaf] = entry.leaf_hashes[leaf];
+      } else {
+        stale_leaves.push_back(leaf);
+      }
+    }
+  }
+
+  if (stale_leaves.empty()) {
+    return hash_leaf_hashes(leaf_hashes.get(), num_leaves);
+  }
+
+  // the lock is not held while hashing, so that threads transferring other
+  // buffers are not held up
+  HASH_T hash;
+  if (stale_leaves.size() == num_leaves) {
+    hash = hash_buffer_leaves(data, bytes, leaf_hashes.get());
+  } else {
+    for (size_t leaf : stale_leaves) {
+      leaf_hashes[leaf] = hash_leaf(data, bytes, leaf);
+    }
+    hash = hash_leaf_hashes(leaf_hashes.get(), num_leaves);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    const auto it = s_cache.find({addr, bytes});
+    if (it != s_cache.end()) {
+      // If a new epoch started while hashing, the leaves are recorded with
+      // the previous epoch and so will be rehashed next time.
+      cached_buffer_t &entry = it->second;
+      for (size_t leaf : stale_leaves) {
+        entry.leaf_hashes[leaf] = leaf_hashes[leaf];
+        entry.leaf_epochs[leaf] = epoch;
+      }
+    }
+    // The leaves that were just hashed can only be reused once the soft-dirty
+    // bits have been cleared.
+    if (steady_clock::now() - s_last_clear >= k_min_clear_interval) {
+      start_new_epoch();
+    }
+  }
+  return hash;
+}
+
+void hash_cache_invalidate(const void *data, size_t bytes) {
+  const uintptr_t start = reinterpret_cast<uintptr_t>(data);
+  const uintptr_t end = start + bytes;
+  std::lock_guard<std::mutex> lock(s_cache_mutex);
+  for (auto it = s_cache.begin();
+       it != s_cache.end() && it->first.first < end;) {
+    const auto [addr, len] = it->first;
+    if (addr + len > start) {
+      it = s_cache.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return;
+}
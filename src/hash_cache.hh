@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+
+#include "hash.hh"
+
+/* Cache of the leaf hashes (see hasher.hh) of host buffers that are
+ * transferred to a device. The kernel's soft-dirty page bits, read from
+ * /proc/self/pagemap, tell which pages have been written since the bits were
+ * last cleared, so that only the leaves overlapping such pages need to be
+ * rehashed when the same buffer is transferred again.
+ *
+ * The soft-dirty bits are process wide and are cleared by writing to
+ * /proc/self/clear_refs, which starts a new epoch. A leaf hash is only reused
+ * if it was computed during the current epoch and none of the leaf's pages
+ * have been written since. Before the bits are cleared, every cached leaf that
+ * is still valid is carried over into the new epoch.
+ *
+ * Limitations:
+ *  - A page written by the application in the short window between the
+ *    validation of the cache and the clearing of the soft-dirty bits is missed.
+ *  - Memory written without going through the page tables (e.g. by a device
+ *    or network adapter doing DMA) does not set the soft-dirty bits. Host
+ *    ranges written by transfers from a device are invalidated explicitly, but
+ *    other such writes are not detected.
+ *  - After the bits are cleared, the first write to each page of the process
+ *    takes a minor page fault.
+ */
+
+// buffers smaller than this are always hashed in full
+constexpr size_t k_hash_cache_min_bytes = 256 * 1024;
+
+/* Enables the cache. Returns false, leaving the cache disabled, if soft-dirty
+ * tracking is not supported by the kernel.
+ */
+bool hash_cache_init();
+
+/* Returns true if the cache is enabled.
+ */
+bool hash_cache_enabled();
+
+/* Returns the same hash as hash_buffer(), only rehashing the leaves of the
+ * buffer that may have changed since it was last hashed. 'bytes' must be at
+ * least k_hash_cache_min_bytes.
+ */
+HASH_T hash_cache_hash(const void *data, size_t bytes);
+
+/* Forgets the cached hashes of every buffer overlapping the given range.
+ */
+void hash_cache_invalidate(const void *data, size_t bytes);
@@ -0,0 +1,108 @@
+#include "hash_crc.hh"
+
+#include <array>
+
+/* Portable variant of CRC32C_x8 and the parts shared by every variant. Built
+ * without any instruction set extension.
+ */
+
+namespace {
+// CRC32C polynomial, bit reflected
+constexpr uint32_t k_crc32c_poly = 0x82f63b78;
+
+typedef std::array<std::array<uint32_t, 256>, sizeof(uint64_t)> crc_tables_t;
+
+/* Tables for slice-by-8: table k holds the CRC of each byte followed by k zero
+ * bytes.
+ */
+constexpr crc_tables_t make_crc_tables() {
+  crc_tables_t tables = {};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) ? k_crc32c_poly : 0);
+    }
+    tables[0][i] = crc;
+  }
+  for (size_t k = 1; k < tables.size(); ++k) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      const uint32_t prev = tables[k - 1][i];
+      tables[k][i] = (prev >> 8) ^ tables[0][prev & 0xff];
+    }
+  }
+  return tables;
+}
+
+constexpr crc_tables_t k_crc_tables = make_crc_tables();
+
+uint64_t load_le64(const unsigned char *p) {
+  uint64_t word = 0;
+  for (size_t i = 0; i < sizeof(word); ++i) {
+    word |= static_cast<uint64_t>(p[i]) << (8 * i);
+  }
+  return word;
+}
+
+/* Same as the CRC32 instruction on a 64 bit word.
+ */
+uint32_t crc32c_word(uint32_t crc, uint64_t word) {
+  word ^= crc;
+  uint32_t result = 0;
+  for (size_t i = 0; i < sizeof(word); ++i) {
+    result ^= k_crc_tables[sizeof(word) - 1 - i][(word >> (8 * i)) & 0xff];
+  }
+  return result;
+}
+
+void update_block(uint32_t lanes[k_crc_lanes], const unsigned char *block) {
+  for (size_t lane = 0; lane < k_crc_lanes; ++lane) {
+    lanes[lane] = crc32c_word(lanes[lane], load_le64(block + 8 * lane));
+  }
+  return;
+}
+
+uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= UINT64_C(0xff51afd7ed558ccd);
+  k ^= k >> 33;
+  k *= UINT64_C(0xc4ceb9fe1a85ec53);
+  k ^= k >> 33;
+  return k;
+}
+} // namespace
+
+HASH_T crc32c_x8(const void *data, size_t bytes) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint32_t lanes[k_crc_lanes];
+  for (size_t lane = 0; lane < k_crc_lanes; ++lane) {
+    lanes[lane] = k_crc_seed;
+  }
+  size_t offset = 0;
+  for (; bytes - offset >= k_crc_block_bytes; offset += k_crc_block_bytes) {
+    update_block(lanes, p + offset);
+  }
+  if (offset < bytes) {
+    unsigned char last[k_crc_block_bytes] = {};
+    for (size_t i = 0; offset + i < bytes; ++i) {
+      last[i] = p[offset + i];
+    }
+    update_block(lanes, last);
+  }
+  return crc32c_x8_finalize(lanes, bytes);
+}
+
+HASH_T crc32c_x8_finalize(const uint32_t lanes[k_crc_lanes], size_t bytes) {
+  const auto pair = [&](size_t lane) {
+    return lanes[lane] | (static_cast<uint64_t>(lanes[lane + 1]) << 32);
+  };
+  uint64_t h1 = pair(0) ^ fmix64(pair(4) ^ bytes);
+  uint64_t h2 =
+      pair(2) ^ fmix64(pair(6) + bytes * UINT64_C(0x9e3779b97f4a7c15));
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+  return HASH_T{h1, h2};
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hash.hh"
+
+/* Built-in CRC32C_x8 hash engine, which needs nothing from hashes/. The data
+ * is read as 64 byte blocks whose eight 8 byte words feed eight independent
+ * CRC32C streams (lanes), the last block being zero padded. The eight 32 bit
+ * lane CRCs and the length are then mixed into a 128 bit fingerprint.
+ *
+ * Every variant computes the same fingerprints:
+ *  - portable: slice-by-8 tables, runs anywhere.
+ *  - sse42: the CRC32 instruction, the lanes hide its latency.
+ *  - avx2, avx512: carry-less multiplies (VPCLMULQDQ) fold the lanes 256 bits
+ *    at a time in 256 or 512 bit registers, the CRC32 instruction reduces
+ *    them to 32 bits at the end.
+ * CRC32C is linear, so the lanes only resist accidental collisions: two
+ * buffers collide if they differ by a multiple of the CRC32C polynomial in
+ * every lane.
+ *
+ * Its speed has not been compared with the functions of hashes/, so it is only
+ * the default when they are not built. benchmark_hash_overhead() in
+ * eval/benchmark.py measures them all on a given machine.
+ */
+
+constexpr size_t k_crc_lanes = 8;
+constexpr size_t k_crc_block_bytes = k_crc_lanes * sizeof(uint64_t);
+// initial CRC of every lane
+constexpr uint32_t k_crc_seed = 0xffffffff;
+
+HASH_T crc32c_x8(const void *data, size_t bytes);
+HASH_T crc32c_x8_sse42(const void *data, size_t bytes);
+HASH_T crc32c_x8_avx2(const void *data, size_t bytes);
+HASH_T crc32c_x8_avx512(const void *data, size_t bytes);
+
+/* Feeds the 'bytes' bytes starting at 'data' to 'lanes', zero padding the last
+ * block, with the CRC32 instruction. Shared with the vector variants, which
+ * leave the blocks that do not fill their registers to it.
+ */
+void crc32c_x8_update_sse42(uint32_t lanes[k_crc_lanes], const void *data,
+                            size_t bytes);
+
+/* Mixes the lane CRCs of a buffer of 'bytes' bytes into its fingerprint.
+ */
+HASH_T crc32c_x8_finalize(const uint32_t lanes[k_crc_lanes], size_t bytes);
@@ -0,0 +1,110 @@
+#include "hash_crc.hh"
+
+#include <immintrin.h>
+
+/* CRC32C_x8 with VPCLMULQDQ on 256 bit registers, this file is built with
+ * AVX2, VPCLMULQDQ and SSE4.2 enabled. It is only called once the processor is
+ * known to support them (see hash_init()).
+ *
+ * A lane that was fed the words w1, w2 has the same CRC as one fed w1', w2'
+ * if w1' w2' and w1 w2 followed by 128 zero bits are congruent modulo the
+ * polynomial. Carry-less multiplies of w1 and w2 by x^(n+31) and x^(n-33)
+ * modulo the polynomial, bit reflected, give such a pair shifted by n bits,
+ * which the next words are xored into. Only the final pair is reduced, by
+ * feeding it to the CRC32 instruction.
+ */
+
+namespace {
+// four blocks are folded at a time, two per accumulator
+constexpr size_t k_group_bytes = 4 * k_crc_block_bytes;
+constexpr size_t k_num_accs = 8;
+
+constexpr uint64_t k_fold256_first = 0x3da6d0cb;  // x^287
+constexpr uint64_t k_fold256_second = 0xba4fc28e; // x^223
+constexpr uint64_t k_fold128_first = 0xf20c0dfe;  // x^159
+constexpr uint64_t k_fold128_second = 0x493c7d27; // x^95
+
+__m256i fold(__m256i acc, __m256i k) {
+  return _mm256_xor_si256(_mm256_clmulepi64_epi128(acc, k, 0x00),
+                          _mm256_clmulepi64_epi128(acc, k, 0x11));
+}
+
+__m256i load(const unsigned char *p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+/* Pairs the words of two consecutive blocks by lane, 'pairs[i]' holding lanes
+ * lane_of(i, 0) and lane_of(i, 1).
+ */
+void pair_words(const unsigned char *p, __m256i pairs[4]) {
+  const __m256i x0 = load(p);
+  const __m256i x1 = load(p + 32);
+  const __m256i y0 = load(p + 64);
+  const __m256i y1 = load(p + 96);
+  pairs[0] = _mm256_unpacklo_epi64(x0, y0);
+  pairs[1] = _mm256_unpackhi_epi64(x0, y0);
+  pairs[2] = _mm256_unpacklo_epi64(x1, y1);
+  pairs[3] = _mm256_unpackhi_epi64(x1, y1);
+  return;
+}
+
+size_t lane_of(size_t pair, size_t half) {
+  return 4 * (pair / 2) + pair % 2 + 2 * half;
+}
+
+/* Feeds 'bytes' bytes, a multiple of k_group_bytes, to 'lanes'.
+ */
+void fold_lanes(uint32_t lanes[k_crc_lanes], const unsigned char *p,
+                size_t bytes) {
+  // blocks 0 and 1 of a group go to accs[0-3], 2 and 3 to accs[4-7]
+  __m256i accs[k_num_accs];
+  pair_words(p, accs);
+  pair_words(p + 128, accs + 4);
+  // the CRC of a lane is folded into its first word
+  for (size_t i = 0; i < 4; ++i) {
+    const __m256i seed =
+        _mm256_set_epi64x(0, lanes[lane_of(i, 1)], 0, lanes[lane_of(i, 0)]);
+    accs[i] = _mm256_xor_si256(accs[i], seed);
+  }
+
+  const __m256i k256 = _mm256_broadcastsi128_si256(
+      _mm_set_epi64x(k_fold256_second, k_fold256_first));
+  for (size_t offset = k_group_bytes; offset < bytes;
+       offset += k_group_bytes) {
+    __m256i pairs[k_num_accs];
+    pair_words(p + offset, pairs);
+    pair_words(p + offset + 128, pairs + 4);
+    for (size_t i = 0; i < k_num_accs; ++i) {
+      accs[i] = _mm256_xor_si256(fold(accs[i], k256), pairs[i]);
+    }
+  }
+
+  const __m256i k128 = _mm256_broadcastsi128_si256(
+      _mm_set_epi64x(k_fold128_second, k_fold128_first));
+  for (size_t i = 0; i < 4; ++i) {
+    uint64_t words[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(words),
+                        _mm256_xor_si256(fold(accs[i], k128), accs[i + 4]));
+    // the CRC of the two words of a lane is that of everything it was fed
+    for (size_t half = 0; half < 2; ++half) {
+      lanes[lane_of(i, half)] = static_cast<uint32_t>(_mm_crc32_u64(
+          _mm_crc32_u64(0, words[2 * half]), words[2 * half + 1]));
+    }
+  }
+  return;
+}
+} // namespace
+
+HASH_T crc32c_x8_avx2(const void *data, size_t bytes) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint32_t lanes[k_crc_lanes];
+  for (size_t lane = 0; lane < k_crc_lanes; ++lane) {
+    lanes[lane] = k_crc_seed;
+  }
+  const size_t vector_bytes = bytes / k_group_bytes * k_group_bytes;
+  if (vector_bytes > 0) {
+    fold_lanes(lanes, p, vector_bytes);
+  }
+  crc32c_x8_update_sse42(lanes, p + vector_bytes, bytes - vector_bytes);
+  return crc32c_x8_finalize(lanes, bytes);
+}
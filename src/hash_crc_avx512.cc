@@ -0,0 +1,96 @@
+#include "hash_crc.hh"
+
+#include <immintrin.h>
+
+/* CRC32C_x8 with VPCLMULQDQ on 512 bit registers, this file is built with
+ * AVX-512, VPCLMULQDQ and SSE4.2 enabled. It is only called once the processor
+ * is known to support them (see hash_init()).
+ */
+
+namespace {
+// four blocks are folded at a time, two per accumulator
+constexpr size_t k_group_bytes = 4 * k_crc_block_bytes;
+
+/* Multiplying the first and second words of a lane by these (x^287 and x^223
+ * modulo the polynomial, bit reflected) shifts it by 256 bits, see
+ * hash_crc_avx2.cc.
+ */
+constexpr uint64_t k_fold256_first = 0x3da6d0cb;
+constexpr uint64_t k_fold256_second = 0xba4fc28e;
+// and by 128 bits (x^159 and x^95)
+constexpr uint64_t k_fold128_first = 0xf20c0dfe;
+constexpr uint64_t k_fold128_second = 0x493c7d27;
+
+__m512i fold(__m512i acc, __m512i k) {
+  return _mm512_xor_si512(_mm512_clmulepi64_epi128(acc, k, 0x00),
+                          _mm512_clmulepi64_epi128(acc, k, 0x11));
+}
+
+__m512i load(const unsigned char *p) {
+  return _mm512_loadu_si512(reinterpret_cast<const void *>(p));
+}
+
+/* Feeds 'bytes' bytes, a multiple of k_group_bytes, to 'lanes'. Each 128 bit
+ * lane of the accumulators holds the first and second words of a CRC lane,
+ * the even lanes in 'even' and the odd ones in 'odd'.
+ */
+void fold_lanes(uint32_t lanes[k_crc_lanes], const unsigned char *p,
+                size_t bytes) {
+  // the CRC of a lane is folded into its first word
+  const __m512i seed_even = _mm512_set_epi64(0, lanes[6], 0, lanes[4], 0,
+                                             lanes[2], 0, lanes[0]);
+  const __m512i seed_odd = _mm512_set_epi64(0, lanes[7], 0, lanes[5], 0,
+                                            lanes[3], 0, lanes[1]);
+  // blocks 0 and 1 of a group go to even0 and odd0, 2 and 3 to even1 and odd1
+  __m512i even0 = _mm512_xor_si512(
+      _mm512_unpacklo_epi64(load(p), load(p + 64)), seed_even);
+  __m512i odd0 = _mm512_xor_si512(
+      _mm512_unpackhi_epi64(load(p), load(p + 64)), seed_odd);
+  __m512i even1 = _mm512_unpacklo_epi64(load(p + 128), load(p + 192));
+  __m512i odd1 = _mm512_unpackhi_epi64(load(p + 128), load(p + 192));
+
+  const __m512i k256 = _mm512_broadcast_i32x4(
+      _mm_set_epi64x(k_fold256_second, k_fold256_first));
+  for (size_t offset = k_group_bytes; offset < bytes;
+       offset += k_group_bytes) {
+    const unsigned char *group = p + offset;
+    const __m512i b0 = load(group);
+    const __m512i b1 = load(group + 64);
+    const __m512i b2 = load(group + 128);
+    const __m512i b3 = load(group + 192);
+    even0 = _mm512_xor_si512(fold(even0, k256), _mm512_unpacklo_epi64(b0, b1));
+    odd0 = _mm512_xor_si512(fold(odd0, k256), _mm512_unpackhi_epi64(b0, b1));
+    even1 = _mm512_xor_si512(fold(even1, k256), _mm512_unpacklo_epi64(b2, b3));
+    odd1 = _mm512_xor_si512(fold(odd1, k256), _mm512_unpackhi_epi64(b2, b3));
+  }
+
+  const __m512i k128 = _mm512_broadcast_i32x4(
+      _mm_set_epi64x(k_fold128_second, k_fold128_first));
+  uint64_t even[k_crc_lanes];
+  uint64_t odd[k_crc_lanes];
+  _mm512_storeu_si512(even, _mm512_xor_si512(fold(even0, k128), even1));
+  _mm512_storeu_si512(odd, _mm512_xor_si512(fold(odd0, k128), odd1));
+  // the CRC of the two words of a lane is that of everything it was fed
+  for (size_t i = 0; i < k_crc_lanes / 2; ++i) {
+    lanes[2 * i] = static_cast<uint32_t>(
+        _mm_crc32_u64(_mm_crc32_u64(0, even[2 * i]), even[2 * i + 1]));
+    lanes[2 * i + 1] = static_cast<uint32_t>(
+        _mm_crc32_u64(_mm_crc32_u64(0, odd[2 * i]), odd[2 * i + 1]));
+  }
+  return;
+}
+} // namespace
+
+HASH_T crc32c_x8_avx512(const void *data, size_t bytes) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint32_t lanes[k_crc_lanes];
+  for (size_t lane = 0; lane < k_crc_lanes; ++lane) {
+    lanes[lane] = k_crc_seed;
+  }
+  const size_t vector_bytes = bytes / k_group_bytes * k_group_bytes;
+  if (vector_bytes > 0) {
+    fold_lanes(lanes, p, vector_bytes);
+  }
+  crc32c_x8_update_sse42(lanes, p + vector_bytes, bytes - vector_bytes);
+  return crc32c_x8_finalize(lanes, bytes);
+}
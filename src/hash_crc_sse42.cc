@@ -0,0 +1,46 @@
+#include "hash_crc.hh"
+
+#include <cstring>
+
+#include <nmmintrin.h>
+
+/* CRC32C_x8 with the CRC32 instruction, this file is built with SSE4.2
+ * enabled. It is only called once the processor is known to support it (see
+ * hash_init()).
+ */
+
+namespace {
+void update_block(uint32_t lanes[k_crc_lanes], const unsigned char *block) {
+  uint64_t words[k_crc_lanes];
+  memcpy(words, block, sizeof(words));
+  for (size_t lane = 0; lane < k_crc_lanes; ++lane) {
+    lanes[lane] =
+        static_cast<uint32_t>(_mm_crc32_u64(lanes[lane], words[lane]));
+  }
+  return;
+}
+} // namespace
+
+void crc32c_x8_update_sse42(uint32_t lanes[k_crc_lanes], const void *data,
+                            size_t bytes) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  size_t offset = 0;
+  for (; bytes - offset >= k_crc_block_bytes; offset += k_crc_block_bytes) {
+    update_block(lanes, p + offset);
+  }
+  if (offset < bytes) {
+    unsigned char last[k_crc_block_bytes] = {};
+    memcpy(last, p + offset, bytes - offset);
+    update_block(lanes, last);
+  }
+  return;
+}
+
+HASH_T crc32c_x8_sse42(const void *data, size_t bytes) {
+  uint32_t lanes[k_crc_lanes];
+  for (size_t lane = 0; lane < k_crc_lanes; ++lane) {
+    lanes[lane] = k_crc_seed;
+  }
+  crc32c_x8_update_sse42(lanes, data, bytes);
+  return crc32c_x8_finalize(lanes, bytes);
+}
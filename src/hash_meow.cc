@@ -0,0 +1,14 @@
+#include "hash.hh"
+
+#include <meow_hash_x64_aesni.h>
+
+/* Meow hash is written with AES-NI intrinsics, so this file is the only one
+ * built with AES-NI enabled. It is only called once the processor is known to
+ * support it (see hash_init()).
+ */
+HASH_T meow128(const void *data, size_t bytes) {
+  const meow_u128 hash =
+      MeowHash(MeowDefaultSeed, bytes, const_cast<void *>(data));
+  return HASH_T{static_cast<uint64_t>(MeowU64From(hash, 0)),
+                static_cast<uint64_t>(MeowU64From(hash, 1))};
+}
@@ -0,0 +1,90 @@
+#include "hash_verify.hh"
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+namespace {
+// the fingerprints are split into shards by hash so that threads rarely
+// contend
+constexpr size_t k_num_shards = 64;
+
+typedef std::tuple<HASH_T, size_t /*bytes*/, HASH_T /*verify_hash*/>
+    fingerprint_pair_t;
+
+typedef struct shard {
+  std::mutex mutex;
+  // ordered so that the pairs sharing a fingerprint are adjacent
+  std::set<fingerprint_pair_t> pairs;
+  // number of pairs whose fingerprint was already seen with another
+  // verification fingerprint
+  uint64_t collisions = 0;
+} shard_t;
+
+std::unique_ptr<shard_t[]> s_shards;
+
+size_t get_shard_index(const HASH_T &hash) {
+  return fingerprint_mix(hash) % k_num_shards;
+}
+} // namespace
+
+void hash_verify_init() {
+  s_shards = std::make_unique<shard_t[]>(k_num_shards);
+  std::cerr << "info: verifying fingerprints with "
+            << get_verify_hash_backend().name << "\n";
+  return;
+}
+
+void hash_verify(const HASH_T &hash, const void *data, size_t bytes) {
+  const fingerprint_pair_t pair(hash, bytes,
+                                get_verify_hash_backend().fn(data, bytes));
+  shard_t &shard = s_shards[get_shard_index(hash)];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const auto [it, inserted] = shard.pairs.insert(pair);
+  if (!inserted) {
+    return;
+  }
+  // the pair is new, it collides if another pair shares its fingerprint
+  const auto same_fingerprint = [&](const fingerprint_pair_t &other) {
+    return std::get<0>(other) == hash && std::get<1>(other) == bytes;
+  };
+  const auto next = std::next(it);
+  if ((it != shard.pairs.begin() && same_fingerprint(*std::prev(it))) ||
+      (next != shard.pairs.end() && same_fingerprint(*next))) {
+    shard.collisions += 1;
+  }
+  return;
+}
+
+void print_hash_verify_summary() {
+  uint64_t num_collisions = 0;
+  uint64_t num_unique_keys = 0;
+  for (size_t i = 0; i < k_num_shards; ++i) {
+    std::lock_guard<std::mutex> lock(s_shards[i].mutex);
+    num_collisions += s_shards[i].collisions;
+    num_unique_keys += s_shards[i].pairs.size();
+  }
+
+  float percent_collisions = 0.f;
+  if (num_unique_keys > 0) {
+    percent_collisions = (num_collisions / (float)num_unique_keys) * 100.f;
+  }
+  std::ostringstream percent_collisions_oss;
+  percent_collisions_oss << std::fixed << std::showpoint << std::setprecision(2)
+                         << percent_collisions << "%";
+  std::cerr << "\nVerified fingerprints with "
+            << get_verify_hash_backend().name << ": found " << std::dec
+            << num_collisions << " collisions for " << num_unique_keys
+            << " unique keys for an estimated collision rate of "
+            << percent_collisions_oss.str() << ".\n";
+  return;
+}
+
+void hash_verify_shutdown() {
+  s_shards.reset();
+  return;
+}
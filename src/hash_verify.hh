@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include "hash.hh"
+
+/* Verification of fingerprints with a second, independent hash function (see
+ * get_verify_hash_backend()). Both fingerprints of every distinct buffer are
+ * remembered, and a buffer whose fingerprint was already seen along with
+ * another verification fingerprint collides with an earlier buffer. This
+ * estimates the collision rate in a constant amount of memory per distinct
+ * buffer, where the exact check keeps a copy of every buffer. Collisions of
+ * both functions at once go unnoticed, which is far less likely than
+ * collisions of either one.
+ */
+
+/* Must be called before any fingerprint is verified.
+ */
+void hash_verify_init();
+
+/* Verifies 'hash', the fingerprint of the 'bytes' bytes starting at 'data'.
+ * Thread safe.
+ */
+void hash_verify(const HASH_T &hash, const void *data, size_t bytes);
+
+/* Prints the number of collisions found.
+ */
+void print_hash_verify_summary();
+
+/* Frees the fingerprints remembered.
+ */
+void hash_verify_shutdown();
@@ -0,0 +1,399 @@
+#include "hasher.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+// the constant scan checks blocks of growing size, so that data that is not
+// constant is usually rejected after its first block
+constexpr size_t k_min_scan_block_bytes = 256;
+constexpr size_t k_max_scan_block_bytes = 64 * 1024;
+// Streamed buffers are prefetched this far ahead of where they are read. The
+// prefetched lines must still be in L1 when they are read, since a demand miss
+// would allocate them in every level of the cache.
+constexpr size_t k_stream_chunk_bytes = 4096;
+constexpr size_t k_cache_line_bytes = 64;
+
+// buffers of at least this many bytes are streamed, 0 if disabled
+size_t s_streaming_bytes = 0;
+// number of leaves claimed at once by a thread taking part in a hash
+constexpr size_t k_leaves_per_batch = 16;
+// leaf hashes of buffers with up to this many leaves are kept on the stack
+constexpr size_t k_max_stack_leaves = 256;
+
+/* A buffer whose leaves are being hashed by the pool.
+ */
+typedef struct hash_job {
+  const unsigned char *data;
+  size_t bytes;
+  size_t num_leaves;
+  size_t num_batches;
+  HASH_T *leaf_hashes;
+  std::atomic<size_t> next_batch;
+  // number of helpers holding a reference to this job, protected by
+  // s_pool_mutex
+  size_t refs;
+} hash_job_t;
+
+std::vector<std::thread> s_pool;
+std::deque<hash_job_t *> s_pool_jobs;
+std::mutex s_pool_mutex;
+std::condition_variable s_pool_cv;
+std::condition_variable s_pool_done_cv;
+bool s_pool_shutdown = false;
+// cpu time of the helpers that have exited, protected by s_pool_mutex
+uint64_t s_pool_cpu_ns = 0;
+
+bool use_streaming(size_t bytes) {
+  return s_streaming_bytes != 0 && bytes >= s_streaming_bytes;
+}
+
+/* Prefetches the 'bytes' bytes starting at 'data' into L1 only, as far as the
+ * processor allows.
+ */
+void prefetch_nta(const unsigned char *data, size_t bytes) {
+  for (size_t offset = 0; offset < bytes; offset += k_cache_line_bytes) {
+    __builtin_prefetch(data + offset, 0 /*read*/, 0 /*no temporal locality*/);
+  }
+  return;
+}
+
+/* Hashes leaf 'leaf' of the 'bytes' bytes starting at 'data'.
+ */
+HASH_T hash_leaf_of(const unsigned char *data, size_t bytes, size_t leaf) {
+  const size_t offset = leaf * k_hash_leaf_bytes;
+  const size_t len = std::min(k_hash_leaf_bytes, bytes - offset);
+  if (use_streaming(bytes)) {
+    return hash_streaming_with(hash_bytes, data + offset, len);
+  }
+  return hash_bytes(data + offset, len);
+}
+
+void hash_leaves(const unsigned char *data, size_t bytes, size_t first,
+                 size_t last, HASH_T *leaf_hashes) {
+  for (size_t i = first; i < last; ++i) {
+    leaf_hashes[i] = hash_leaf_of(data, bytes, i);
+  }
+  return;
+}
+
+/* Hashes batches of the job's leaves until there are none left to claim.
+ */
+void work_on(hash_job_t *job) {
+  size_t batch;
+  while ((batch = job->next_batch.fetch_add(1, std::memory_order_relaxed)) <
+         job->num_batches) {
+    const size_t first = batch * k_leaves_per_batch;
+    const size_t last = std::min(first + k_leaves_per_batch, job->num_leaves);
+    hash_leaves(job->data, job->bytes, first, last, job->leaf_hashes);
+  }
+  return;
+}
+
+void helper_main() {
+  std::unique_lock<std::mutex> lock(s_pool_mutex);
+  while (true) {
+    s_pool_cv.wait(lock,
+                   [] { return s_pool_shutdown || !s_pool_jobs.empty(); });
+    if (s_pool_shutdown) {
+      struct timespec ts;
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        s_pool_cpu_ns += ts.tv_sec * 1'000'000'000ull + ts.tv_nsec;
+      }
+      return;
+    }
+    hash_job_t *job = s_pool_jobs.front();
+    if (job->next_batch.load(std::memory_order_relaxed) >= job->num_batches) {
+      // every batch has been claimed, nothing left to help with
+      s_pool_jobs.pop_front();
+      continue;
+    }
+    job->refs += 1;
+    lock.unlock();
+    work_on(job);
+    lock.lock();
+    // The job's owner waits for refs to drop to zero while holding the mutex,
+    // so the job must not be touched after this.
+    job->refs -= 1;
+    if (job->refs == 0) {
+      s_pool_done_cv.notify_all();
+    }
+  }
+}
+
+/* Queues the job so that helper threads start working on it.
+ */
+void submit_job(hash_job_t *job, const unsigned char *data, size_t bytes,
+                size_t num_leaves, HASH_T *leaf_hashes) {
+  job->data = data;
+  job->bytes = bytes;
+  job->num_leaves = num_leaves;
+  job->num_batches =
+      (num_leaves + k_leaves_per_batch - 1) / k_leaves_per_batch;
+  job->leaf_hashes = leaf_hashes;
+  job->next_batch.store(0, std::memory_order_relaxed);
+  job->refs = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(s_pool_mutex);
+    s_pool_jobs.push_back(job);
+  }
+  s_pool_cv.notify_all();
+  return;
+}
+
+/* Works on the job until every leaf has been hashed. Once this returns no
+ * helper thread refers to the job any longer.
+ */
+void finish_job(hash_job_t *job) {
+  // the calling thread works on the job as well
+  work_on(job);
+
+  std::unique_lock<std::mutex> lock(s_pool_mutex);
+  for (auto it = s_pool_jobs.begin(); it != s_pool_jobs.end(); ++it) {
+    if (*it == job) {
+      s_pool_jobs.erase(it);
+      break;
+    }
+  }
+  s_pool_done_cv.wait(lock, [job] { return job->refs == 0; });
+  return;
+}
+
+size_t get_num_leaves(size_t bytes) {
+  return (bytes + k_hash_leaf_bytes - 1) / k_hash_leaf_bytes;
+}
+} // namespace
+
+struct hash_task {
+  hash_job_t job;
+  std::unique_ptr<HASH_T[]> leaf_hashes;
+};
+
+void hash_streaming_init(size_t min_bytes) {
+  s_streaming_bytes = min_bytes;
+  return;
+}
+
+HASH_T hash_streaming_with(HASH_T (*fn)(const void *data, size_t bytes),
+                           const void *data, size_t bytes) {
+  // The hash functions are opaque and read their input in one go, so the data
+  // is first copied to a buffer of the thread's which stays in L2, prefetching
+  // each chunk before it is copied.
+  static thread_local std::unique_ptr<unsigned char[]> s_bounce;
+  if (s_bounce == nullptr) {
+    s_bounce = std::make_unique<unsigned char[]>(k_hash_leaf_bytes);
+  }
+  assert(bytes <= k_hash_leaf_bytes);
+  const unsigned char *const src = static_cast<const unsigned char *>(data);
+  prefetch_nta(src, std::min(k_stream_chunk_bytes, bytes));
+  for (size_t offset = 0; offset < bytes; offset += k_stream_chunk_bytes) {
+    const size_t len = std::min(k_stream_chunk_bytes, bytes - offset);
+    const size_t next = offset + len;
+    prefetch_nta(src + next, std::min(k_stream_chunk_bytes, bytes - next));
+    memcpy(s_bounce.get() + offset, src + offset, len);
+  }
+  return fn(s_bounce.get(), bytes);
+}
+
+void hash_pool_init(int num_threads, const std::vector<int> &cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  s_pool_shutdown = false;
+  for (int i = 0; i < num_threads; ++i) {
+    s_pool.emplace_back(helper_main);
+    if (!cpus.empty()) {
+      pthread_setaffinity_np(s_pool.back().native_handle(), sizeof(cpu_set),
+                             &cpu_set);
+    }
+  }
+  return;
+}
+
+void hash_pool_shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(s_pool_mutex);
+    s_pool_shutdown = true;
+  }
+  s_pool_cv.notify_all();
+  for (std::thread &helper : s_pool) {
+    helper.join();
+  }
+  s_pool.clear();
+  return;
+}
+
+int hash_pool_size() { return s_pool.size(); }
+
+std::chrono::duration<uint64_t, std::nano> hash_pool_cpu_time() {
+  std::lock_guard<std::mutex> lock(s_pool_mutex);
+  return std::chrono::duration<uint64_t, std::nano>(s_pool_cpu_ns);
+}
+
+size_t hash_num_leaves(size_t bytes) { return get_num_leaves(bytes); }
+
+HASH_T hash_leaf(const void *data, size_t bytes, size_t leaf) {
+  return hash_leaf_of(static_cast<const unsigned char *>(data), bytes, leaf);
+}
+
+HASH_T hash_buffer_leaves(const void *data, size_t bytes,
+                          HASH_T *leaf_hashes) {
+  assert(bytes > k_hash_leaf_bytes);
+  const unsigned char *bytes_ptr = static_cast<const unsigned char *>(data);
+  const size_t num_leaves = get_num_leaves(bytes);
+  if (bytes >= k_parallel_hash_bytes && !s_pool.empty()) {
+    hash_job_t job;
+    submit_job(&job, bytes_ptr, bytes, num_leaves, leaf_hashes);
+    finish_job(&job);
+  } else {
+    hash_leaves(bytes_ptr, bytes, 0, num_leaves, leaf_hashes);
+  }
+  return hash_leaf_hashes(leaf_hashes, num_leaves);
+}
+
+namespace {
+/* Returns true if every 8 bytes of the 'bytes' bytes starting at 'data' equal
+ * 'pattern'. 'bytes' must be a multiple of 64.
+ */
+bool is_constant_block(const unsigned char *data, size_t bytes,
+                       uint64_t pattern) {
+#if defined(__SSE2__)
+  // independent accumulators so that the loads are not serialized
+  const __m128i pattern_vec = _mm_set1_epi64x(pattern);
+  __m128i diff0 = _mm_setzero_si128();
+  __m128i diff1 = _mm_setzero_si128();
+  __m128i diff2 = _mm_setzero_si128();
+  __m128i diff3 = _mm_setzero_si128();
+  for (size_t i = 0; i < bytes; i += 64) {
+    const __m128i *ptr = reinterpret_cast<const __m128i *>(data + i);
+    diff0 =
+        _mm_or_si128(diff0, _mm_xor_si128(_mm_loadu_si128(ptr), pattern_vec));
+    diff1 = _mm_or_si128(diff1,
+                         _mm_xor_si128(_mm_loadu_si128(ptr + 1), pattern_vec));
+    diff2 = _mm_or_si128(diff2,
+                         _mm_xor_si128(_mm_loadu_si128(ptr + 2), pattern_vec));
+    diff3 = _mm_or_si128(diff3,
+                         _mm_xor_si128(_mm_loadu_si128(ptr + 3), pattern_vec));
+  }
+  const __m128i diff =
+      _mm_or_si128(_mm_or_si128(diff0, diff1), _mm_or_si128(diff2, diff3));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xffff;
+#else
+  uint64_t diff = 0;
+  for (size_t i = 0; i < bytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    diff |= word ^ pattern;
+  }
+  return diff == 0;
+#endif
+}
+} // namespace
+
+bool find_constant_pattern(const void *data, size_t bytes, uint64_t &pattern) {
+  static_assert(k_inline_payload_bytes >= k_constant_pattern_bytes);
+  assert(bytes > k_inline_payload_bytes);
+  const unsigned char *bytes_ptr = static_cast<const unsigned char *>(data);
+  memcpy(&pattern, bytes_ptr, sizeof(pattern));
+  const bool streaming = use_streaming(bytes);
+  const size_t max_block_bytes =
+      streaming ? k_stream_chunk_bytes : k_max_scan_block_bytes;
+  size_t offset = 0;
+  size_t block_bytes = k_min_scan_block_bytes;
+  while (bytes - offset >= 64) {
+    const size_t len = std::min(block_bytes, (bytes - offset) & ~size_t(63));
+    if (streaming) {
+      // the next block, as the current one was prefetched along with it
+      const size_t next = offset + len;
+      prefetch_nta(bytes_ptr + next,
+                   std::min(std::min(2 * block_bytes, max_block_bytes),
+                            bytes - next));
+      if (offset == 0) {
+        prefetch_nta(bytes_ptr, len);
+      }
+    }
+    if (!is_constant_block(bytes_ptr + offset, len, pattern)) {
+      return false;
+    }
+    offset += len;
+    block_bytes = std::min(2 * block_bytes, max_block_bytes);
+  }
+  // the pattern continues through the last bytes
+  const unsigned char *pattern_bytes =
+      reinterpret_cast<const unsigned char *>(&pattern);
+  for (; offset < bytes; ++offset) {
+    if (bytes_ptr[offset] != pattern_bytes[offset % sizeof(pattern)]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+HASH_T hash_leaf_hashes(const HASH_T *leaf_hashes, size_t num_leaves) {
+  return hash_bytes(leaf_hashes, num_leaves * sizeof(HASH_T));
+}
+
+HASH_T hash_buffer(const void *data, size_t bytes) {
+  if (bytes <= k_hash_leaf_bytes) {
+    return hash_bytes(data, bytes);
+  }
+
+  const size_t num_leaves = get_num_leaves(bytes);
+  HASH_T stack_leaf_hashes[k_max_stack_leaves];
+  std::unique_ptr<HASH_T[]> heap_leaf_hashes;
+  HASH_T *leaf_hashes = stack_leaf_hashes;
+  if (num_leaves > k_max_stack_leaves) {
+    heap_leaf_hashes = std::make_unique<HASH_T[]>(num_leaves);
+    leaf_hashes = heap_leaf_hashes.get();
+  }
+  return hash_buffer_leaves(data, bytes, leaf_hashes);
+}
+
+hash_task_t *hash_buffer_begin(const void *data, size_t bytes) {
+  if (bytes < k_background_hash_bytes || s_pool.empty()) {
+    return nullptr;
+  }
+  static_assert(k_background_hash_bytes > k_hash_leaf_bytes);
+  hash_task_t *task = new (std::nothrow) hash_task_t();
+  if (task == nullptr) {
+    return nullptr;
+  }
+  const size_t num_leaves = get_num_leaves(bytes);
+  task->leaf_hashes.reset(new (std::nothrow) HASH_T[num_leaves]);
+  if (task->leaf_hashes == nullptr) {
+    delete task;
+    return nullptr;
+  }
+  submit_job(&task->job, static_cast<const unsigned char *>(data), bytes,
+             num_leaves, task->leaf_hashes.get());
+  return task;
+}
+
+HASH_T hash_buffer_end(hash_task_t *task) {
+  assert(task != nullptr);
+  finish_job(&task->job);
+  const HASH_T hash =
+      hash_leaf_hashes(task->leaf_hashes.get(), task->job.num_leaves);
+  delete task;
+  return hash;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "hash.hh"
+
+/* Buffers larger than a leaf are hashed as a two level tree: each leaf is
+ * hashed on its own and the resulting array of leaf hashes is hashed again.
+ * The leaves of large buffers are hashed in parallel by a pool of helper
+ * threads. The tree shape only depends on the size of the buffer, so a buffer
+ * always hashes to the same value no matter how many helpers hashed it.
+ */
+constexpr size_t k_hash_leaf_bytes = 64 * 1024;
+// minimum size of a buffer for its leaves to be hashed in parallel
+constexpr size_t k_parallel_hash_bytes = 8 * 1024 * 1024;
+// minimum size of a buffer to be hashed in the background while it is being
+// transferred
+constexpr size_t k_background_hash_bytes = 1024 * 1024;
+
+/* Transfers of at most k_inline_payload_bytes bytes are not hashed, their data
+ * is stored zero padded in place of the hash instead. The analyses compare
+ * transfers by size as well as by hash, so these compare exactly.
+ */
+constexpr size_t k_inline_payload_bytes = sizeof(HASH_T);
+
+inline HASH_T inline_payload(const void *data, size_t bytes) {
+  HASH_T payload = {};
+  memcpy(&payload, data, bytes);
+  return payload;
+}
+
+/* Larger transfers whose data repeats its first k_constant_pattern_bytes bytes
+ * throughout, such as zero filled arrays or arrays filled with a single value,
+ * are not hashed either. Their fingerprint is the repeated pattern followed by
+ * k_constant_tag, which hash functions are unlikely to produce.
+ */
+constexpr size_t k_constant_pattern_bytes = sizeof(uint64_t);
+constexpr uint64_t k_constant_tag = UINT64_C(0x636f6e7374616e74);
+
+inline HASH_T constant_fingerprint(uint64_t pattern) {
+  return HASH_T{pattern, k_constant_tag};
+}
+
+inline bool is_constant_fingerprint(const HASH_T &hash, size_t bytes) {
+  return bytes > k_inline_payload_bytes && hash.high64 == k_constant_tag;
+}
+
+/* Returns true if the 'bytes' bytes starting at 'data' repeat their first
+ * k_constant_pattern_bytes bytes throughout, and stores those in 'pattern'.
+ * Stops at the first differing block, so the scan is short unless the data is
+ * mostly constant. 'bytes' must be more than k_inline_payload_bytes.
+ */
+bool find_constant_pattern(const void *data, size_t bytes, uint64_t &pattern);
+
+/* A hash being computed in the background by the helper threads.
+ */
+typedef struct hash_task hash_task_t;
+
+/* Buffers of at least 'min_bytes' bytes are read with non-temporal prefetches
+ * when they are hashed or scanned, so that they stream through the caches
+ * without evicting the application's working set. 0 disables this. Must be
+ * called before anything is hashed.
+ */
+void hash_streaming_init(size_t min_bytes);
+
+/* Hashes 'bytes' bytes, at most a leaf, starting at 'data' with 'fn' without
+ * leaving them in the caches, the way the leaves of streamed buffers are
+ * hashed. Also used to time the hash functions on cold data.
+ */
+HASH_T hash_streaming_with(HASH_T (*fn)(const void *data, size_t bytes),
+                           const void *data, size_t bytes);
+
+/* Starts 'num_threads' helper threads. If 'cpus' is not empty the helpers are
+ * restricted to run on those cpus.
+ */
+void hash_pool_init(int num_threads, const std::vector<int> &cpus);
+
+/* Stops and joins the helper threads.
+ */
+void hash_pool_shutdown();
+
+/* Returns the number of helper threads.
+ */
+int hash_pool_size();
+
+/* Returns the cpu time used by the helper threads. Only complete once the
+ * helpers have been joined by hash_pool_shutdown().
+ */
+std::chrono::duration<uint64_t, std::nano> hash_pool_cpu_time();
+
+/* Hashes 'bytes' bytes starting at 'data'.
+ */
+HASH_T hash_buffer(const void *data, size_t bytes);
+
+/* Returns the number of leaves of a buffer of 'bytes' bytes.
+ */
+size_t hash_num_leaves(size_t bytes);
+
+/* Hashes leaf 'leaf' of the 'bytes' bytes starting at 'data'.
+ */
+HASH_T hash_leaf(const void *data, size_t bytes, size_t leaf);
+
+/* Hashes every leaf of a buffer larger than a leaf, storing the leaf hashes in
+ * 'leaf_hashes', and returns the hash of the buffer.
+ */
+HASH_T hash_buffer_leaves(const void *data, size_t bytes, HASH_T *leaf_hashes);
+
+/* Returns the hash of a buffer larger than a leaf given the hashes of its
+ * leaves.
+ */
+HASH_T hash_leaf_hashes(const HASH_T *leaf_hashes, size_t num_leaves);
+
+/* Starts hashing 'bytes' bytes starting at 'data' on the helper threads and
+ * returns without waiting for the hash. The buffer must not be modified until
+ * the hash is retrieved with hash_buffer_end(). Returns nullptr if there are no
+ * helper threads or if the buffer is too small to be worth handing off, in
+ * which case the caller should use hash_buffer() instead.
+ */
+hash_task_t *hash_buffer_begin(const void *data, size_t bytes);
+
+/* Waits for a hash started with hash_buffer_begin() to complete, helping with
+ * whatever work remains, and returns the hash. 'task' is freed.
+ */
+HASH_T hash_buffer_end(hash_task_t *task);
@@ -0,0 +1,76 @@
+#include "op_table.hh"
+
+#include <cassert>
+#include <iostream>
+#include <new>
+
+#include "arena.hh"
+
+namespace {
+op_slot_t *s_slots = nullptr;
+size_t s_capacity = 0;
+// used to give each thread its own starting point when searching for a free
+// slot so that threads rarely contend for the same slots
+std::atomic<size_t> s_next_cursor = 0;
+thread_local size_t t_cursor = SIZE_MAX;
+
+size_t slot_index(uint64_t handle) { return (handle & 0xffffffff) - 1; }
+uint32_t slot_state(uint64_t handle) { return handle >> 32; }
+} // namespace
+
+void op_table_init(size_t capacity) {
+  assert(capacity > 0 && capacity < UINT32_MAX);
+  void *mem = arena_alloc(capacity * sizeof(op_slot_t), 64);
+  if (mem == nullptr) {
+    std::cerr << "warning: failed to allocate the operation table. "
+                 "Asynchronous operations will not be timed.\n";
+    return;
+  }
+  s_slots = static_cast<op_slot_t *>(mem);
+  for (size_t i = 0; i < capacity; ++i) {
+    new (&s_slots[i]) op_slot_t();
+  }
+  s_capacity = capacity;
+  return;
+}
+
+uint64_t op_table_acquire(op_slot_t **slot) {
+  if (t_cursor == SIZE_MAX) [[unlikely]] {
+    // spread threads out across the table, one cache line apart
+    t_cursor = s_next_cursor.fetch_add(64 / sizeof(op_slot_t) + 1,
+                                       std::memory_order_relaxed);
+  }
+  for (size_t probe = 0; probe < s_capacity; ++probe) {
+    const size_t idx = (t_cursor + probe) % s_capacity;
+    op_slot_t &s = s_slots[idx];
+    uint32_t state = s.state.load(std::memory_order_relaxed);
+    if ((state & 1) != 0) {
+      continue; // slot in use
+    }
+    if (s.state.compare_exchange_strong(state, state + 1,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+      t_cursor = idx + 1;
+      *slot = &s;
+      return (static_cast<uint64_t>(state + 1) << 32) | (idx + 1);
+    }
+  }
+  return 0;
+}
+
+op_slot_t *op_table_lookup(uint64_t handle) {
+  if (handle == 0 || slot_index(handle) >= s_capacity) {
+    return nullptr;
+  }
+  op_slot_t *s = &s_slots[slot_index(handle)];
+  if (s->state.load(std::memory_order_acquire) != slot_state(handle)) {
+    return nullptr;
+  }
+  return s;
+}
+
+void op_table_release(op_slot_t *slot) {
+  assert((slot->state.load(std::memory_order_relaxed) & 1) != 0);
+  slot->state.fetch_add(1, std::memory_order_release);
+  return;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+struct hash_task;
+
+/* State carried from the begin endpoint of a target operation to its end
+ * endpoint.
+ */
+typedef struct op_state {
+  std::chrono::steady_clock::time_point start_time;
+  // hash of the transferred data being computed while the transfer runs, or
+  // nullptr
+  struct hash_task *hash_task;
+  // false if the operation is only timed, not hashed and logged
+  bool sampled;
+  // true if the transferred data was found to be constant when the operation
+  // began, in which case it repeats 'pattern' (see find_constant_pattern())
+  bool constant;
+  uint64_t pattern;
+} op_state_t;
+
+/* Slot holding the state of an asynchronous target operation in flight.
+ */
+typedef struct op_slot {
+  // odd while the slot is in use, incremented on every acquire and release so
+  // that handles to a previous use of the slot can be detected
+  std::atomic<uint32_t> state;
+  op_state_t op;
+} op_slot_t;
+
+/* The op table is a fixed size table of slots shared by all threads. The begin
+ * endpoint of an asynchronous operation acquires a slot and stores the handle
+ * in the ompt_data_t or ompt_id_t that the runtime passes back to the end
+ * endpoint, which may run on a different thread. Acquiring, looking up and
+ * releasing a slot are lock-free and O(1) in the common case.
+ */
+
+/* Sets up a table with room for 'capacity' operations in flight at once.
+ */
+void op_table_init(size_t capacity);
+
+/* Acquires a free slot, storing a pointer to it in 'slot'. Returns the handle
+ * of the slot, which is never 0, or 0 if every slot is in use.
+ */
+uint64_t op_table_acquire(op_slot_t **slot);
+
+/* Returns the slot referred to by 'handle', or nullptr if 'handle' does not
+ * refer to an acquired slot.
+ */
+op_slot_t *op_table_lookup(uint64_t handle);
+
+/* Releases the slot referred to by 'handle'. The slot must have been looked up
+ * successfully.
+ */
+void op_table_release(op_slot_t *slot);
@@ -0,0 +1,77 @@
+#include "packed_log.hh"
+
+using namespace std::chrono;
+
+namespace {
+constexpr size_t k_chunk_data_bytes =
+    k_arena_chunk_bytes - sizeof(ChunkList::chunk_t);
+} // namespace
+
+uint32_t PackedDataOpLog::intern_site(const void *codeptr_ra) {
+  if (codeptr_ra == m_last_site && !m_sites.empty()) {
+    return m_last_site_index;
+  }
+  const auto [it, inserted] =
+      m_site_index.try_emplace(codeptr_ra, m_sites.size());
+  if (inserted) {
+    m_sites.push_back(codeptr_ra);
+  }
+  m_last_site = codeptr_ra;
+  m_last_site_index = it->second;
+  return it->second;
+}
+
+bool PackedDataOpLog::emplace_back(ompt_target_data_op_t optype,
+                                   void *src_addr, void *dest_addr,
+                                   int src_device_num, int dest_device_num,
+                                   size_t bytes, const void *codeptr_ra,
+                                   uint64_t target_id,
+                                   steady_clock::time_point start_time,
+                                   steady_clock::time_point end_time,
+                                   const HASH_T &hash) {
+  chunk_t *tail = m_chunks.tail();
+  if (tail == nullptr ||
+      tail->size + k_max_packed_record_bytes > k_chunk_data_bytes)
+      [[unlikely]] {
+    if (!m_chunks.grow()) {
+      return false;
+    }
+    tail = m_chunks.tail();
+    m_state = {};
+    if (m_size == 0) {
+      m_hash_bytes = packed_hash_width(get_hash_backend().bits);
+    }
+  }
+
+  data_op_info_t info;
+  info.optype = optype;
+  info.src_addr = src_addr;
+  info.dest_addr = dest_addr;
+  info.src_device_num = src_device_num;
+  info.dest_device_num = dest_device_num;
+  info.bytes = bytes;
+  info.codeptr_ra = codeptr_ra;
+  info.target_id = target_id;
+  info.start_time = start_time;
+  info.end_time = end_time;
+  info.hash = hash;
+  unsigned char *const record = chunk_data(tail) + tail->size;
+  unsigned char *const p =
+      pack_data_op(record, info, intern_site(codeptr_ra), m_hash_bytes,
+                   m_state);
+  tail->size += p - record;
+  m_bytes += p - record;
+  ++m_size;
+  return true;
+}
+
+void PackedDataOpLog::release() {
+  m_chunks.release();
+  m_size = 0;
+  m_bytes = 0;
+  m_sites.clear();
+  m_site_index.clear();
+  m_last_site = nullptr;
+  m_last_site_index = 0;
+  return;
+}
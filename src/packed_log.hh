@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "analyze.hh"
+#include "arena.hh"
+#include "packed_record.hh"
+
+/* Log of data op events stored in the variable length encoding of
+ * packed_record.hh, and decoded back into data_op_info_t only when the log is
+ * read. Deltas restart at the beginning of each chunk so that chunks can be
+ * decoded independently of each other, including after they were spilled. A
+ * typical record takes about a third of the size of a data_op_info_t.
+ *
+ * Like ChunkedLog, a PackedDataOpLog has a single writer.
+ */
+class PackedDataOpLog {
+private:
+  typedef ChunkList::chunk_t chunk_t;
+
+  ChunkList m_chunks;
+  size_t m_size = 0;
+  size_t m_bytes = 0;
+  // call site table, codeptr_ra of each index, allocated from the arena
+  std::pmr::vector<const void *> m_sites = decltype(m_sites)(arena_resource());
+  std::pmr::unordered_map<const void *, uint32_t> m_site_index =
+      decltype(m_site_index)(arena_resource());
+  // the most recently used call site, most events repeat it
+  const void *m_last_site = nullptr;
+  uint32_t m_last_site_index = 0;
+  // values the next record is delta encoded against
+  packed_state_t m_state = {};
+  // hashes are stored on the width of the selected hash function
+  size_t m_hash_bytes = sizeof(HASH_T);
+
+  static unsigned char *chunk_data(const chunk_t *c) {
+    return reinterpret_cast<unsigned char *>(reinterpret_cast<uintptr_t>(c) +
+                                             sizeof(chunk_t));
+  }
+
+  /* Returns the index of 'codeptr_ra' in the call site table, adding it if
+   * needed.
+   */
+  uint32_t intern_site(const void *codeptr_ra);
+
+public:
+  /* Appends a data op to the log. Returns false, and drops the event, if the
+   * arena is out of memory.
+   */
+  bool emplace_back(ompt_target_data_op_t optype, void *src_addr,
+                    void *dest_addr, int src_device_num, int dest_device_num,
+                    size_t bytes, const void *codeptr_ra, uint64_t target_id,
+                    std::chrono::steady_clock::time_point start_time,
+                    std::chrono::steady_clock::time_point end_time,
+                    const HASH_T &hash);
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  /* Returns the number of bytes taken by the encoded records.
+   */
+  size_t encoded_bytes() const { return m_bytes; }
+
+  /* Returns the number of bytes of the chunks held in memory, including the
+   * unused end of each chunk and the call site table.
+   */
+  size_t resident_bytes() const {
+    return m_chunks.resident_bytes() +
+           m_sites.capacity() * sizeof(const void *);
+  }
+
+  /* Calls 'fn' on every event, decoded into a data_op_info_t, in the order
+   * they were appended.
+   */
+  template <typename Fn> void for_each(Fn &&fn) const {
+    m_chunks.for_each_chunk([this, &fn](const chunk_t *c) {
+      const unsigned char *p = chunk_data(c);
+      const unsigned char *end = p + c->size;
+      packed_state_t state = {};
+      data_op_info_t info;
+      uint64_t site_index;
+      while (p < end) {
+        p = unpack_data_op(p, info, site_index, m_hash_bytes, state);
+        info.codeptr_ra = m_sites[site_index];
+        fn(info);
+      }
+    });
+  }
+
+  /* Empties the log and returns the memory held by its chunks to the
+   * operating system.
+   */
+  void release();
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "analyze.hh"
+#include "hasher.hh"
+
+/* Variable length encoding of data op records, shared by the in memory data
+ * op log (see packed_log.hh) and trace files (see trace.hh). A record is
+ *   optype                      1 byte
+ *   src_device_num              zigzag varint
+ *   dest_device_num             zigzag varint
+ *   start_time                  zigzag varint, delta from the previous record
+ *   end_time                    zigzag varint, delta from start_time
+ *   src_addr                    zigzag varint, delta from the previous record
+ *   dest_addr                   zigzag varint, delta from the previous record
+ *   bytes                       varint
+ *   codeptr_ra                  varint index into a call site table
+ *   target_id                   varint, 0 if none, otherwise one more than
+ *                               the zigzag delta from the previous nonzero id
+ *   hash                        transfers only, the 'bytes' bytes of an
+ *                               inline payload, the k_constant_pattern_bytes
+ *                               bytes of the pattern of a constant
+ *                               fingerprint, or the low 'hash_bytes' bytes
+ *                               of the hash otherwise
+ * Varints are little endian base 128. Optypes fit in 7 bits, the top bit of
+ * the optype byte is set for constant fingerprints. 'hash_bytes' is the width
+ * of the selected hash function, whose hashes are zero extended to HASH_T, so
+ * the bytes left out are zeros. The encoding does not depend on the layout of
+ * data_op_info_t.
+ */
+
+constexpr size_t k_max_varint_bytes = 10;
+constexpr unsigned char k_packed_constant_flag = 0x80;
+// upper bound on the size of an encoded record
+constexpr size_t k_max_packed_record_bytes =
+    1 + 8 * k_max_varint_bytes + 5 + sizeof(HASH_T);
+
+inline uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline unsigned char *put_varint(unsigned char *p, uint64_t value) {
+  while (value >= 0x80) {
+    *p++ = static_cast<unsigned char>(value) | 0x80;
+    value >>= 7;
+  }
+  *p++ = static_cast<unsigned char>(value);
+  return p;
+}
+
+inline const unsigned char *get_varint(const unsigned char *p,
+                                       uint64_t &value) {
+  value = 0;
+  int shift = 0;
+  while ((*p & 0x80) && shift < 63) {
+    value |= static_cast<uint64_t>(*p++ & 0x7f) << shift;
+    shift += 7;
+  }
+  value |= static_cast<uint64_t>(*p++) << shift;
+  return p;
+}
+
+/* Values the next record is delta encoded against. A zero initialized state
+ * starts a new run of records, which can be decoded on its own.
+ */
+typedef struct packed_state {
+  int64_t prev_start;
+  uintptr_t prev_src;
+  uintptr_t prev_dest;
+  uint64_t prev_target_id;
+} packed_state_t;
+
+/* Returns the number of bytes hashes of 'hash_bits' bits are stored on.
+ */
+inline size_t packed_hash_width(unsigned int hash_bits) {
+  return std::min<size_t>((hash_bits + 7) / 8, sizeof(HASH_T));
+}
+
+/* Returns the number of hash bytes stored for a data op.
+ */
+inline size_t packed_hash_bytes(ompt_target_data_op_t optype, size_t bytes,
+                                bool constant, size_t hash_bytes) {
+  if (!is_transfer_op(optype)) {
+    return 0;
+  }
+  if (bytes <= k_inline_payload_bytes) {
+    return bytes;
+  }
+  return constant ? k_constant_pattern_bytes : hash_bytes;
+}
+
+/* Encodes 'info' at 'p', with 'site_index' in place of its codeptr_ra and
+ * hashes stored on 'hash_bytes' bytes, and returns the end of the record. At
+ * most k_max_packed_record_bytes bytes are written.
+ */
+inline unsigned char *pack_data_op(unsigned char *p,
+                                   const data_op_info_t &info,
+                                   uint32_t site_index, size_t hash_bytes,
+                                   packed_state_t &state) {
+  const int64_t start = info.start_time.time_since_epoch().count();
+  const int64_t end = info.end_time.time_since_epoch().count();
+  const uintptr_t src = reinterpret_cast<uintptr_t>(info.src_addr);
+  const uintptr_t dest = reinterpret_cast<uintptr_t>(info.dest_addr);
+
+  const bool constant = is_transfer_op(info.optype) &&
+                        is_constant_fingerprint(info.hash, info.bytes);
+  *p++ = static_cast<unsigned char>(info.optype) |
+         (constant ? k_packed_constant_flag : 0);
+  p = put_varint(p, zigzag(info.src_device_num));
+  p = put_varint(p, zigzag(info.dest_device_num));
+  p = put_varint(p, zigzag(start - state.prev_start));
+  p = put_varint(p, zigzag(end - start));
+  p = put_varint(p, zigzag(src - state.prev_src));
+  p = put_varint(p, zigzag(dest - state.prev_dest));
+  p = put_varint(p, info.bytes);
+  p = put_varint(p, site_index);
+  if (info.target_id != 0) {
+    p = put_varint(p, zigzag(info.target_id - state.prev_target_id) + 1);
+    state.prev_target_id = info.target_id;
+  } else {
+    p = put_varint(p, 0);
+  }
+  const size_t stored =
+      packed_hash_bytes(info.optype, info.bytes, constant, hash_bytes);
+  memcpy(p, &info.hash, stored);
+  p += stored;
+
+  state.prev_start = start;
+  state.prev_src = src;
+  state.prev_dest = dest;
+  return p;
+}
+
+/* Decodes the record at 'p', with hashes stored on 'hash_bytes' bytes, into
+ * 'info', except for its codeptr_ra whose call site index is stored in
+ * 'site_index', and returns the start of the next record. At most
+ * k_max_packed_record_bytes bytes are read.
+ */
+inline const unsigned char *unpack_data_op(const unsigned char *p,
+                                           data_op_info_t &info,
+                                           uint64_t &site_index,
+                                           size_t hash_bytes,
+                                           packed_state_t &state) {
+  using namespace std::chrono;
+  uint64_t value;
+  const bool constant = (*p & k_packed_constant_flag) != 0;
+  info.optype = static_cast<ompt_target_data_op_t>(*p++ &
+                                                   ~k_packed_constant_flag);
+  p = get_varint(p, value);
+  info.src_device_num = unzigzag(value);
+  p = get_varint(p, value);
+  info.dest_device_num = unzigzag(value);
+  p = get_varint(p, value);
+  const int64_t start = state.prev_start + unzigzag(value);
+  p = get_varint(p, value);
+  const int64_t end = start + unzigzag(value);
+  p = get_varint(p, value);
+  const uintptr_t src = state.prev_src + unzigzag(value);
+  p = get_varint(p, value);
+  const uintptr_t dest = state.prev_dest + unzigzag(value);
+  p = get_varint(p, value);
+  info.bytes = value;
+  p = get_varint(p, site_index);
+  p = get_varint(p, value);
+  if (value != 0) {
+    state.prev_target_id += unzigzag(value - 1);
+    info.target_id = state.prev_target_id;
+  } else {
+    info.target_id = 0;
+  }
+  const size_t stored =
+      packed_hash_bytes(info.optype, info.bytes, constant, hash_bytes);
+  info.hash = HASH_T();
+  memcpy(&info.hash, p, stored);
+  p += stored;
+  if (constant) {
+    info.hash.high64 = k_constant_tag;
+  }
+
+  info.start_time = steady_clock::time_point(steady_clock::duration(start));
+  info.end_time = steady_clock::time_point(steady_clock::duration(end));
+  info.src_addr = reinterpret_cast<void *>(src);
+  info.dest_addr = reinterpret_cast<void *>(dest);
+  state.prev_start = start;
+  state.prev_src = src;
+  state.prev_dest = dest;
+  return p;
+}
@@ -6,10 +6,26 @@
 #include <iostream>
 #include <string>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 const char *OMPDATAPERF_VERSION = "0.0.1-alpha";
 
+/* Options that enable an optional mode of the tool, along with the environment
+ * variable the tool reads the mode from.
+ */
+// clang-format off
+const std::pair<const char *, const char *> k_mode_options[] = {
+  {"counters",             "OMPDATAPERF_COUNTERS"},
+  {"check-collisions",     "OMPDATAPERF_CHECK_COLLISIONS"},
+  {"verify-hashes",        "OMPDATAPERF_VERIFY_HASHES"},
+  {"measure-hashing",      "OMPDATAPERF_MEASURE_HASHING"},
+  {"print-space-overhead", "OMPDATAPERF_PRINT_SPACE_OVERHEAD"},
+  {"print-transfer-rate",  "OMPDATAPERF_PRINT_TRANSFER_RATE"},
+  {"self-profile",         "OMPDATAPERF_SELF_PROFILE"},
+};
+// clang-format on
+
 void print_help() {
   std::cout << "Usage: ompdataperf [options] [program] [program arguments]\n";
   std::cout << "Options:\n";
@@ -17,6 +33,20 @@ void print_help() {
   std::cout << "  -q, --quiet             Suppress warnings\n";
   std::cout << "  -v, --verbose           Enable verbose output\n";
   std::cout << "  --version               Print the version of ompdataperf\n";
+  std::cout << "  --counters              Only count the data operations of "
+               "each call site\n"
+               "                          (low overhead, nothing is hashed)\n";
+  std::cout << "  --check-collisions      Count hash collisions (slow, keeps a "
+               "copy of all\n"
+               "                          transferred data)\n";
+  std::cout << "  --verify-hashes         Estimate the hash collision rate "
+               "with a second hash\n";
+  std::cout << "  --measure-hashing       Print the time spent hashing\n";
+  std::cout << "  --print-space-overhead  Print the size of the event log\n";
+  std::cout << "  --print-transfer-rate   Print the average data transfer "
+               "rate\n";
+  std::cout << "  --self-profile          Print the overhead of the tool "
+               "itself\n";
 }
 
 void print_version() {
@@ -113,11 +143,18 @@ int main(int argc, char *argv[]) {
 
   // clang-format off
   static struct option long_options[] = {
-    {"help",    no_argument,       nullptr, 'h'},
-    {"verbose", no_argument,       nullptr, 'v'},
-    {"version", no_argument,       nullptr,  0 },
- // {"outfile", required_argument, nullptr, 'o'},
-    {nullptr,   0,                 nullptr,  0 }
+    {"help",                 no_argument,       nullptr, 'h'},
+    {"verbose",              no_argument,       nullptr, 'v'},
+    {"version",              no_argument,       nullptr,  0 },
+    {"counters",             no_argument,       nullptr,  0 },
+    {"check-collisions",     no_argument,       nullptr,  0 },
+    {"verify-hashes",        no_argument,       nullptr,  0 },
+    {"measure-hashing",      no_argument,       nullptr,  0 },
+    {"print-space-overhead", no_argument,       nullptr,  0 },
+    {"print-transfer-rate",  no_argument,       nullptr,  0 },
+    {"self-profile",         no_argument,       nullptr,  0 },
+ // {"outfile",              required_argument, nullptr, 'o'},
+    {nullptr,                0,                 nullptr,  0 }
   };
   // clang-format on
 
@@ -142,6 +179,11 @@ int main(int argc, char *argv[]) {
         print_version();
         return 0;
       }
+      for (const auto &[name, env_name] : k_mode_options) {
+        if (strcmp(long_options[option_index].name, name) == 0) {
+          safe_setenv(env_name, "1", 1 /*overwrite*/);
+        }
+      }
       break;
     case '?':
       // getopt_long already printed an error message.
@@ -171,11 +213,18 @@ int main(int argc, char *argv[]) {
   setenv_omp_tool();
   setenv_omp_tool_libraries(argv[0]);
   setenv_omp_tool_verbose_init(verbose);
+  if (verbose) {
+    safe_setenv("OMPDATAPERF_VERBOSE", "1", 1 /*overwrite*/);
+  }
 
   if (verbose) {
     print_env("OMP_TOOL");
     print_env("OMP_TOOL_LIBRARIES");
     print_env("OMP_TOOL_VERBOSE_INIT");
+    print_env("OMPDATAPERF_VERBOSE");
+    for (const auto &[name, env_name] : k_mode_options) {
+      print_env(env_name);
+    }
 
     // print command being profiled
     std::cout << "info: profiling \'" << argv[optind];
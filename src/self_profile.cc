@@ -0,0 +1,224 @@
+#include "self_profile.hh"
+
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "analyze.hh"
+#include "arena.hh"
+#include "clock.hh"
+
+using namespace std::chrono;
+
+namespace {
+constexpr int f_w = 10; // column width
+constexpr int f_w_bytes = 13;
+
+// once this many memory samples are held every other one is dropped
+constexpr size_t k_max_memory_samples = 32;
+
+std::mutex s_memory_mutex;
+std::vector<memory_sample_t> s_memory_samples;
+// only 1 in 's_memory_stride' of the offered samples is kept
+uint64_t s_memory_stride = 1;
+uint64_t s_memory_offered = 0;
+
+const char *const k_phase_names[k_num_profile_phases] = {"callback", "clock",
+                                                         "hash", "log"};
+
+uint64_t to_ns(uint64_t raw) {
+  return ToolClock::to_steady(duration<uint64_t, std::nano>(raw)).count();
+}
+
+std::string format_size_class(int size_class) {
+  static const char *const k_labels[k_num_profile_hash_classes] = {
+      "  <= 4KiB", "  <= 64KiB", "  <= 1MiB", "  <= 8MiB", "  > 8MiB"};
+  return k_labels[size_class];
+}
+
+duration<uint64_t, std::nano> get_process_cpu_time() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return duration<uint64_t, std::nano>(0);
+  }
+  const uint64_t us = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+                          1'000'000ull +
+                      usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+  return duration<uint64_t, std::nano>(us * 1'000);
+}
+
+void print_latency_histogram(const tool_profile_t &profile) {
+  int first = k_profile_latency_buckets;
+  int last = -1;
+  for (int phase = 0; phase < k_num_profile_phases; ++phase) {
+    for (int i = 0; i < k_profile_latency_buckets; ++i) {
+      if (profile.latency[phase][i] > 0) {
+        first = std::min(first, i);
+        last = std::max(last, i);
+      }
+    }
+  }
+  if (last < 0) {
+    std::cerr << "  no callbacks profiled\n";
+    return;
+  }
+
+  std::cerr << std::left << std::setw(f_w_bytes) << "  latency" << std::right;
+  for (int phase = 0; phase < k_num_profile_phases; ++phase) {
+    std::cerr << std::setw(f_w) << k_phase_names[phase];
+  }
+  std::cerr << "\n";
+  for (int i = first; i <= last; ++i) {
+    if (i == k_profile_latency_buckets - 1) {
+      std::cerr << "  >=" << format_duration(to_ns(1ull << (i - 1)), f_w - 1);
+    } else {
+      std::cerr << "  < " << format_duration(to_ns(1ull << i), f_w - 1);
+    }
+    for (int phase = 0; phase < k_num_profile_phases; ++phase) {
+      std::cerr << format_uint(profile.latency[phase][i], f_w);
+    }
+    std::cerr << "\n";
+  }
+  std::cerr << std::left << std::setw(f_w_bytes) << "  total" << std::right;
+  for (int phase = 0; phase < k_num_profile_phases; ++phase) {
+    std::cerr << format_duration(to_ns(profile.time[phase]), f_w);
+  }
+  std::cerr << "\n";
+  std::cerr << std::left << std::setw(f_w_bytes) << "  avg" << std::right;
+  for (int phase = 0; phase < k_num_profile_phases; ++phase) {
+    const uint64_t calls = profile.calls[phase];
+    std::cerr << format_duration(
+        calls > 0 ? to_ns(profile.time[phase]) / calls : 0, f_w);
+  }
+  std::cerr << "\n";
+  return;
+}
+
+void print_hash_rates(const tool_profile_t &profile) {
+  // clang-format off
+  std::cerr << "\n" << std::left << std::setw(f_w_bytes) << "  hash size"
+            << std::right
+            << std::setw(f_w) << "calls"
+            << std::setw(f_w_bytes) << "bytes"
+            << std::setw(f_w) << "time"
+            << std::setw(f_w) << "rate"
+            << "\n";
+  // clang-format on
+  for (int i = 0; i < k_num_profile_hash_classes; ++i) {
+    if (profile.hash_calls[i] == 0) {
+      continue;
+    }
+    const uint64_t ns = to_ns(profile.hash_time[i]);
+    // B / ns = GB / s
+    const float gb_per_s = ns > 0 ? profile.hash_bytes[i] / (float)ns : 0.f;
+    // clang-format off
+    std::cerr << std::left << std::setw(f_w_bytes) << format_size_class(i)
+              << std::right
+              << format_uint(profile.hash_calls[i], f_w)
+              << format_uint(profile.hash_bytes[i], f_w_bytes)
+              << format_duration(ns, f_w)
+              << format_float(gb_per_s, f_w, 0.001, "GB/s")
+              << "\n";
+    // clang-format on
+  }
+  return;
+}
+
+void print_memory_samples(steady_clock::time_point start_time) {
+  std::lock_guard<std::mutex> lock(s_memory_mutex);
+  // clang-format off
+  std::cerr << "\n" << std::left << std::setw(f_w_bytes) << "  time"
+            << std::right
+            << std::setw(f_w_bytes) << "allocated"
+            << std::setw(f_w_bytes) << "spilled"
+            << "\n";
+  // clang-format on
+  const steady_clock::time_point start = ToolClock::to_steady(start_time);
+  for (const memory_sample_t &sample : s_memory_samples) {
+    const steady_clock::time_point time = ToolClock::to_steady(sample.time);
+    const uint64_t ns = time > start ? (time - start).count() : 0;
+    // clang-format off
+    std::cerr << "  " << format_duration(ns, f_w_bytes - 2)
+              << format_uint(sample.bytes_allocated, f_w_bytes)
+              << format_uint(sample.bytes_spilled, f_w_bytes)
+              << "\n";
+    // clang-format on
+  }
+  return;
+}
+} // namespace
+
+void profile_init(bool enabled) {
+  s_profile_enabled = enabled;
+  if (enabled) {
+    s_memory_samples.reserve(k_max_memory_samples);
+  }
+  return;
+}
+
+void profile_merge(tool_profile_t &profile, const tool_profile_t &other) {
+  for (int phase = 0; phase < k_num_profile_phases; ++phase) {
+    for (int i = 0; i < k_profile_latency_buckets; ++i) {
+      profile.latency[phase][i] += other.latency[phase][i];
+    }
+    profile.calls[phase] += other.calls[phase];
+    profile.time[phase] += other.time[phase];
+  }
+  for (int i = 0; i < k_num_profile_hash_classes; ++i) {
+    profile.hash_calls[i] += other.hash_calls[i];
+    profile.hash_bytes[i] += other.hash_bytes[i];
+    profile.hash_time[i] += other.hash_time[i];
+  }
+  return;
+}
+
+void profile_sample_memory(steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock(s_memory_mutex);
+  if (s_memory_offered++ % s_memory_stride != 0) {
+    return;
+  }
+  if (s_memory_samples.size() == k_max_memory_samples) {
+    // keep every other sample so that they still span the whole execution
+    for (size_t i = 1; 2 * i < s_memory_samples.size(); ++i) {
+      s_memory_samples[i] = s_memory_samples[2 * i];
+    }
+    s_memory_samples.resize(k_max_memory_samples / 2);
+    s_memory_stride *= 2;
+  }
+  s_memory_samples.push_back(
+      {now, arena_bytes_allocated(), arena_bytes_spilled()});
+  return;
+}
+
+void print_self_profile_summary(const tool_profile_t &profile,
+                                duration<uint64_t, std::nano> helper_cpu_time,
+                                duration<uint64_t, std::nano> spill_cpu_time,
+                                steady_clock::time_point start_time) {
+  std::cerr << "\n=== OMPDataPerf Self-Profile ===\n";
+  print_latency_histogram(profile);
+  print_hash_rates(profile);
+  print_memory_samples(start_time);
+
+  const uint64_t callback_ns = to_ns(profile.time[k_phase_callback]);
+  const uint64_t tool_ns =
+      callback_ns + helper_cpu_time.count() + spill_cpu_time.count();
+  // clang-format off
+  std::cerr << "\n  callback wall time    "
+            << format_duration(callback_ns, f_w) << "\n";
+  std::cerr <<   "  helper cpu time       "
+            << format_duration(helper_cpu_time.count(), f_w) << "\n";
+  std::cerr <<   "  spill writer cpu time "
+            << format_duration(spill_cpu_time.count(), f_w) << "\n";
+  std::cerr <<   "  tool time             "
+            << format_duration(tool_ns, f_w) << "\n";
+  std::cerr <<   "  process cpu time      "
+            << format_duration(get_process_cpu_time().count(), f_w) << "\n";
+  // clang-format on
+  std::cerr << "  tool time adds the callback wall time to the helper and "
+               "spill writer cpu time,\n  the analysis is not included.\n";
+  return;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/* Self-profiling of the overhead of the tool itself, enabled with
+ * OMPDATAPERF_SELF_PROFILE. Each thread counts into the tool_profile_t of its
+ * own thread log (see thread_log.hh) without any synchronization, and the
+ * counters of every thread are only combined for the summary. Durations are
+ * raw (see ToolClock) until then.
+ */
+
+typedef enum profile_phase {
+  k_phase_callback,  // a whole callback
+  k_phase_timestamp, // reading the clock
+  k_phase_hash,      // hashing, including waiting for the helper threads
+  k_phase_log,       // appending to the event log or the online index
+  k_num_profile_phases
+} profile_phase_t;
+
+// latency bucket i counts durations shorter than 2^i raw units and at least
+// 2^(i-1), the last bucket counts everything longer
+constexpr int k_profile_latency_buckets = 40;
+
+// hash rates are reported for transfers of up to these many bytes
+constexpr size_t k_profile_hash_classes[] = {4 * 1024, 64 * 1024, 1024 * 1024,
+                                             8 * 1024 * 1024, SIZE_MAX};
+constexpr int k_num_profile_hash_classes =
+    sizeof(k_profile_hash_classes) / sizeof(k_profile_hash_classes[0]);
+
+// the tool's memory use is sampled about every this many callbacks per thread
+constexpr uint64_t k_profile_memory_period = 1024;
+
+typedef struct tool_profile {
+  uint64_t latency[k_num_profile_phases][k_profile_latency_buckets];
+  uint64_t calls[k_num_profile_phases];
+  uint64_t time[k_num_profile_phases];
+  uint64_t hash_calls[k_num_profile_hash_classes];
+  uint64_t hash_bytes[k_num_profile_hash_classes];
+  uint64_t hash_time[k_num_profile_hash_classes];
+} tool_profile_t;
+
+typedef struct memory_sample {
+  std::chrono::steady_clock::time_point time; // raw
+  size_t bytes_allocated;                     // by the arena
+  size_t bytes_spilled;
+} memory_sample_t;
+
+/* Set by profile_init(). Callbacks do not read it, the variant of each callback
+ * that is registered already knows whether it profiles (see tool.cc).
+ */
+inline bool s_profile_enabled = false;
+
+inline bool profile_enabled() { return s_profile_enabled; }
+
+/* Enables or disables self-profiling. Must be called before any callback.
+ */
+void profile_init(bool enabled);
+
+/* Accounts for 'raw' spent in 'phase'.
+ */
+inline void profile_record(tool_profile_t &profile, profile_phase_t phase,
+                           std::chrono::steady_clock::duration raw) {
+  const uint64_t ticks = raw.count() > 0 ? raw.count() : 0;
+  const int bucket =
+      std::min<int>(std::bit_width(ticks), k_profile_latency_buckets - 1);
+  profile.latency[phase][bucket] += 1;
+  profile.calls[phase] += 1;
+  profile.time[phase] += ticks;
+  return;
+}
+
+/* Accounts for the hash of a transfer of 'bytes' bytes that took 'raw'.
+ */
+inline void profile_record_hash(tool_profile_t &profile, size_t bytes,
+                                std::chrono::steady_clock::duration raw) {
+  int size_class = 0;
+  while (bytes > k_profile_hash_classes[size_class]) {
+    size_class += 1;
+  }
+  profile.hash_calls[size_class] += 1;
+  profile.hash_bytes[size_class] += bytes;
+  profile.hash_time[size_class] += raw.count() > 0 ? raw.count() : 0;
+  return;
+}
+
+/* Adds the counters of 'other' to 'profile'.
+ */
+void profile_merge(tool_profile_t &profile, const tool_profile_t &other);
+
+/* Records the memory used by the tool at raw time 'now'. Only a bounded number
+ * of samples evenly spread over the execution are kept. Thread safe.
+ */
+void profile_sample_memory(std::chrono::steady_clock::time_point now);
+
+/* Prints the self-profile. 'profile' holds the combined counters of every
+ * thread, 'helper_cpu_time' is the cpu time of the hash helper threads,
+ * 'spill_cpu_time' that of the spill writer thread and 'start_time' is the raw
+ * time profiling started at. Must only be called once ToolClock is
+ * calibrated.
+ *
+ * The tool time it prints adds the wall time spent in callbacks to the cpu
+ * time of the tool's own threads. It leaves out the analysis at the end of
+ * execution, which is printed as the analysis time.
+ */
+void print_self_profile_summary(
+    const tool_profile_t &profile,
+    std::chrono::duration<uint64_t, std::nano> helper_cpu_time,
+    std::chrono::duration<uint64_t, std::nano> spill_cpu_time,
+    std::chrono::steady_clock::time_point start_time);
@@ -0,0 +1,111 @@
+#include "sparse_hash.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "hasher.hh"
+
+namespace {
+// the first and last pages of a buffer are sampled in full
+constexpr size_t k_page_bytes = 4096;
+// number of cache lines sampled between the first and last pages
+constexpr size_t k_sampled_lines = 1024;
+constexpr size_t k_line_bytes = 64;
+constexpr size_t k_sample_bytes =
+    2 * k_page_bytes + k_sampled_lines * k_line_bytes + sizeof(size_t);
+static_assert(k_sparse_hash_min_bytes >=
+              2 * k_page_bytes + k_sampled_lines * k_line_bytes);
+
+// sparse fingerprints are sharded like the verified ones (see hash_verify.cc)
+constexpr size_t k_num_shards = 64;
+
+/* What is known about the buffers with a given sparse fingerprint.
+ */
+typedef struct sparse_entry {
+  // full hash of the first of these buffers that was hashed in full
+  HASH_T full_hash;
+  bool has_full_hash;
+} sparse_entry_t;
+
+typedef struct shard {
+  std::mutex mutex;
+  std::map<std::pair<HASH_T, size_t /*bytes*/>, sparse_entry_t> index;
+} shard_t;
+
+std::unique_ptr<shard_t[]> s_shards;
+std::atomic<uint64_t> s_num_buffers = 0;
+std::atomic<uint64_t> s_num_full_hashes = 0;
+
+size_t get_shard_index(const HASH_T &hash) {
+  return fingerprint_mix(hash) % k_num_shards;
+}
+
+/* Hashes the length and the sampled bytes of a buffer. The sampled offsets
+ * only depend on the length, never on the address of the buffer.
+ */
+HASH_T sparse_fingerprint(const void *data, size_t bytes) {
+  static thread_local std::unique_ptr<unsigned char[]> s_sample;
+  if (s_sample == nullptr) {
+    s_sample = std::make_unique<unsigned char[]>(k_sample_bytes);
+  }
+  const unsigned char *src = static_cast<const unsigned char *>(data);
+  unsigned char *dst = s_sample.get();
+  memcpy(dst, src, k_page_bytes);
+  dst += k_page_bytes;
+  const size_t middle_bytes = bytes - 2 * k_page_bytes;
+  const size_t stride = middle_bytes / k_sampled_lines;
+  for (size_t i = 0; i < k_sampled_lines; ++i) {
+    const size_t offset = (i * stride) & ~(k_line_bytes - 1);
+    memcpy(dst, src + k_page_bytes + offset, k_line_bytes);
+    dst += k_line_bytes;
+  }
+  memcpy(dst, src + bytes - k_page_bytes, k_page_bytes);
+  dst += k_page_bytes;
+  memcpy(dst, &bytes, sizeof(bytes));
+  return hash_bytes(s_sample.get(), k_sample_bytes);
+}
+} // namespace
+
+void sparse_hash_init() {
+  s_shards = std::make_unique<shard_t[]>(k_num_shards);
+  return;
+}
+
+HASH_T sparse_hash_buffer(const void *data, size_t bytes) {
+  s_num_buffers.fetch_add(1, std::memory_order_relaxed);
+  const HASH_T sparse_hash = sparse_fingerprint(data, bytes);
+  const std::pair<HASH_T, size_t> key(sparse_hash, bytes);
+  shard_t &shard = s_shards[get_shard_index(sparse_hash)];
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.index.emplace(key, sparse_entry_t{{}, false}).second) {
+      // first buffer with this sparse fingerprint
+      return sparse_hash;
+    }
+  }
+
+  // not holding the lock, hashing a huge buffer takes a while
+  s_num_full_hashes.fetch_add(1, std::memory_order_relaxed);
+  const HASH_T full_hash = hash_buffer(data, bytes);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  sparse_entry_t &entry = shard.index[key];
+  if (!entry.has_full_hash) {
+    entry.full_hash = full_hash;
+    entry.has_full_hash = true;
+  }
+  return entry.full_hash == full_hash ? sparse_hash : full_hash;
+}
+
+void print_sparse_hash_summary() {
+  std::cerr << "\ninfo: " << s_num_buffers.load(std::memory_order_relaxed)
+            << " buffers were fingerprinted sparsely, "
+            << s_num_full_hashes.load(std::memory_order_relaxed)
+            << " of them were hashed in full.\n";
+  return;
+}
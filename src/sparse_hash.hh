@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+#include "hash.hh"
+
+/* Sparse fingerprints of huge buffers. Instead of hashing all of a buffer, its
+ * length, its first and last pages and a fixed number of cache lines spread
+ * evenly over the rest of it are hashed, so the cost does not depend on its
+ * size. A buffer is only hashed in full once its sparse fingerprint matches
+ * that of an earlier buffer, i.e. once it may be a duplicate.
+ *
+ * The first buffer with a given sparse fingerprint is never hashed in full, so
+ * the second one is assumed to hold the same data and its full hash stands for
+ * both. Buffers whose full hash differs from it get their full hash as a
+ * fingerprint. Limitations:
+ *  - A buffer that only differs from the first one with the same sparse
+ *    fingerprint outside of the sampled bytes is reported as its duplicate.
+ *  - The fingerprints differ from those of hash_buffer(), so traces written
+ *    with and without sparse fingerprints cannot be compared.
+ */
+
+// buffers smaller than this are always hashed in full
+constexpr size_t k_sparse_hash_min_bytes = 1024 * 1024;
+
+/* Must be called before any buffer is fingerprinted.
+ */
+void sparse_hash_init();
+
+/* Returns the fingerprint of the 'bytes' bytes starting at 'data', hashing
+ * them in full only if they may be a duplicate of an earlier buffer. 'bytes'
+ * must be at least k_sparse_hash_min_bytes. Thread safe.
+ */
+HASH_T sparse_hash_buffer(const void *data, size_t bytes);
+
+/* Prints how many buffers were fingerprinted and how many of them had to be
+ * hashed in full.
+ */
+void print_sparse_hash_summary();
@@ -0,0 +1,255 @@
+#include "stream_detector.hh"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "clock.hh"
+
+using namespace std::chrono;
+
+namespace {
+// the index is split into shards by hash so that threads rarely contend
+constexpr size_t k_num_shards = 64;
+// maximum number of issues of each kind kept per shard for the report, the
+// least costly issues are dropped beyond twice this
+constexpr size_t k_max_shard_issues = 256;
+// maximum number of (src_device_num, codeptr_ra) pairs kept per duplicate
+constexpr size_t k_max_sources = 8;
+
+// data is identified by size as well as by hash so that inline payloads are
+// compared exactly
+typedef std::tuple<HASH_T, size_t /*bytes*/, int /*device_num*/> data_key_t;
+
+/* What is known about a piece of data on a device.
+ */
+typedef struct data_entry {
+  // number of transfers of the data to the device
+  uint64_t arrivals;
+  // the first of these transfers, reported along with the duplicates
+  int first_src_device_num;
+  const void *first_codeptr_ra;
+  duration<uint64_t, std::nano> first_time;
+  // number of transfers of the data away from the device that have not come
+  // back yet, and the latest of them
+  uint64_t departures;
+  int departure_dest_device_num;
+  ompt_target_data_op_t departure_optype;
+  const void *departure_codeptr_ra;
+  duration<uint64_t, std::nano> departure_time;
+  // position in the shard's recency list
+  std::list<data_key_t>::iterator lru_it;
+} data_entry_t;
+
+typedef struct duplicate_group {
+  stream_duplicate_t dup;
+  std::map<std::pair<int /*src_device_num*/, const void * /*codeptr_ra*/>,
+           uint64_t /*calls*/>
+      sources;
+} duplicate_group_t;
+
+typedef struct shard {
+  std::mutex mutex;
+  std::map<data_key_t, data_entry_t> index;
+  // keys of the index, most recently seen first
+  std::list<data_key_t> lru;
+  std::map<data_key_t, duplicate_group_t> duplicates;
+  std::map<std::tuple<HASH_T, size_t /*bytes*/, int /*src_device_num*/,
+                      int /*dest_device_num*/>,
+           stream_round_trip_t>
+      round_trips;
+  uint64_t pot_dd_calls = 0;
+  uint64_t pot_dd_hashes = 0;
+  uint64_t pot_rt_calls = 0;
+  uint64_t pot_trans_calls = 0;
+  uint64_t pot_trans_bytes = 0;
+  duration<uint64_t, std::nano> pot_trans_time{0};
+  uint64_t evictions = 0;
+} shard_t;
+
+std::unique_ptr<shard_t[]> s_shards;
+size_t s_shard_capacity = 0;
+
+size_t get_shard_index(const HASH_T &hash, size_t bytes) {
+  return fingerprint_mix(hash, bytes) % k_num_shards;
+}
+
+/* Returns the index entry of 'key', creating it if needed and evicting the
+ * least recently seen entry if the shard is full. The entry becomes the most
+ * recently seen one.
+ */
+data_entry_t &get_entry(shard_t &shard, const data_key_t &key) {
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru_it);
+    return it->second;
+  }
+  if (shard.index.size() >= s_shard_capacity) {
+    shard.index.erase(shard.lru.back());
+    shard.lru.pop_back();
+    shard.evictions += 1;
+  }
+  shard.lru.push_front(key);
+  data_entry_t &entry = shard.index[key];
+  entry.lru_it = shard.lru.begin();
+  return entry;
+}
+
+void add_source(duplicate_group_t &group, int src_device_num,
+                const void *codeptr_ra) {
+  const std::pair<int, const void *> key(src_device_num, codeptr_ra);
+  auto it = group.sources.find(key);
+  if (it != group.sources.end()) {
+    it->second += 1;
+  } else if (group.sources.size() < k_max_sources) {
+    group.sources.emplace(key, 1);
+  }
+  return;
+}
+
+/* Drops the least costly issues of the map once it holds too many.
+ */
+template <typename Map, typename TimeFn>
+void prune_issues(Map &issues, TimeFn get_time) {
+  if (issues.size() <= 2 * k_max_shard_issues) {
+    return;
+  }
+  std::vector<typename Map::iterator> its;
+  its.reserve(issues.size());
+  for (auto it = issues.begin(); it != issues.end(); ++it) {
+    its.push_back(it);
+  }
+  std::nth_element(its.begin(), its.begin() + k_max_shard_issues, its.end(),
+                   [&get_time](const auto &a, const auto &b) {
+                     return get_time(a->second) > get_time(b->second);
+                   });
+  for (size_t i = k_max_shard_issues; i < its.size(); ++i) {
+    issues.erase(its[i]);
+  }
+  return;
+}
+} // namespace
+
+void stream_init(size_t capacity) {
+  s_shards = std::make_unique<shard_t[]>(k_num_shards);
+  // a transfer touches two entries of the same shard
+  s_shard_capacity = std::max<size_t>(2, capacity / k_num_shards);
+  return;
+}
+
+void stream_record_transfer(const data_op_info_t &transfer) {
+  shard_t &shard = s_shards[get_shard_index(transfer.hash, transfer.bytes)];
+  const duration<uint64_t, std::nano> time =
+      transfer.end_time - transfer.start_time;
+  bool is_unnecessary = false;
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  data_entry_t &dest_entry =
+      get_entry(shard, {transfer.hash, transfer.bytes,
+                        transfer.dest_device_num});
+
+  if (dest_entry.departures > 0) {
+    // the data is coming back to a device it left earlier
+    dest_entry.departures -= 1;
+    const std::tuple<HASH_T, size_t, int, int> trip_key(
+        transfer.hash, transfer.bytes, transfer.dest_device_num,
+        dest_entry.departure_dest_device_num);
+    stream_round_trip_t &trip = shard.round_trips[trip_key];
+    if (trip.trips == 0) {
+      trip.src_device_num = transfer.dest_device_num;
+      trip.dest_device_num = dest_entry.departure_dest_device_num;
+      trip.size = transfer.bytes;
+      trip.tx_optype = dest_entry.departure_optype;
+      trip.rx_optype = transfer.optype;
+      trip.tx_codeptr_ra = dest_entry.departure_codeptr_ra;
+      trip.rx_codeptr_ra = transfer.codeptr_ra;
+    }
+    trip.trips += 1;
+    trip.time += dest_entry.departure_time + time;
+    shard.pot_rt_calls += 1;
+    is_unnecessary = true;
+    prune_issues(shard.round_trips,
+                 [](const stream_round_trip_t &trip) { return trip.time; });
+  }
+
+  dest_entry.arrivals += 1;
+  if (dest_entry.arrivals == 1) {
+    dest_entry.first_src_device_num = transfer.src_device_num;
+    dest_entry.first_codeptr_ra = transfer.codeptr_ra;
+    dest_entry.first_time = time;
+  } else {
+    // the data is already on the device
+    const auto [it, inserted] = shard.duplicates.try_emplace(
+        data_key_t(transfer.hash, transfer.bytes,
+                   transfer.dest_device_num));
+    duplicate_group_t &group = it->second;
+    if (inserted) {
+      group.dup.dest_device_num = transfer.dest_device_num;
+      group.dup.size = transfer.bytes;
+      if (dest_entry.arrivals == 2) {
+        group.dup.calls = 1;
+        group.dup.time = dest_entry.first_time;
+        add_source(group, dest_entry.first_src_device_num,
+                   dest_entry.first_codeptr_ra);
+        shard.pot_dd_hashes += 1;
+      }
+    }
+    group.dup.calls += 1;
+    group.dup.time += time;
+    add_source(group, transfer.src_device_num, transfer.codeptr_ra);
+    shard.pot_dd_calls += 1;
+    is_unnecessary = true;
+    prune_issues(shard.duplicates,
+                 [](const duplicate_group_t &group) { return group.dup.time; });
+  }
+
+  // the capacity of a shard is at least two so this cannot evict dest_entry
+  data_entry_t &src_entry =
+      get_entry(shard, {transfer.hash, transfer.bytes,
+                        transfer.src_device_num});
+  src_entry.departures += 1;
+  src_entry.departure_dest_device_num = transfer.dest_device_num;
+  src_entry.departure_optype = transfer.optype;
+  src_entry.departure_codeptr_ra = transfer.codeptr_ra;
+  src_entry.departure_time = time;
+
+  if (is_unnecessary) {
+    shard.pot_trans_calls += 1;
+    shard.pot_trans_bytes += transfer.bytes;
+    shard.pot_trans_time += time;
+  }
+  return;
+}
+
+void stream_collect(stream_results_t &results) {
+  results = stream_results_t();
+  for (size_t i = 0; s_shards != nullptr && i < k_num_shards; ++i) {
+    shard_t &shard = s_shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto &[key, group] : shard.duplicates) {
+      stream_duplicate_t dup = group.dup;
+      dup.time = ToolClock::to_steady(dup.time);
+      for (const auto &[source, calls] : group.sources) {
+        dup.sources.emplace_back(calls, source.first, source.second);
+      }
+      std::sort(dup.sources.rbegin(), dup.sources.rend());
+      results.duplicates.push_back(dup);
+    }
+    for (auto &[key, trip] : shard.round_trips) {
+      results.round_trips.push_back(trip);
+      results.round_trips.back().time = ToolClock::to_steady(trip.time);
+    }
+    results.pot_dd_calls += shard.pot_dd_calls;
+    results.pot_dd_hashes += shard.pot_dd_hashes;
+    results.pot_rt_calls += shard.pot_rt_calls;
+    results.pot_trans_calls += shard.pot_trans_calls;
+    results.pot_trans_bytes += shard.pot_trans_bytes;
+    results.pot_trans_time += ToolClock::to_steady(shard.pot_trans_time);
+    results.evictions += shard.evictions;
+  }
+  return;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include "analyze.hh"
+
+/* Online detection of duplicate and round trip transfers. Rather than logging
+ * every transfer until the end of execution, each transfer is classified as it
+ * completes against an index of the data recently seen on each device. The
+ * index holds a bounded number of (hash, device) entries and forgets the least
+ * recently seen data when it is full, so memory use is proportional to the
+ * amount of distinct data rather than to the number of transfers. Transfers
+ * whose earlier copies were forgotten are not detected, so results are a
+ * lower bound once entries start being evicted.
+ *
+ * A transfer of data to a device that already received the same data is a
+ * duplicate. A transfer of data to a device that the same data previously left
+ * completes a round trip.
+ */
+
+/* Sets up an index with room for 'capacity' (hash, device) entries.
+ */
+void stream_init(size_t capacity);
+
+/* Classifies a completed transfer. Thread safe.
+ */
+void stream_record_transfer(const data_op_info_t &transfer);
+
+/* Returns the issues detected so far with durations converted by ToolClock.
+ * Must only be called once no other thread can report transfers.
+ */
+void stream_collect(stream_results_t &results);
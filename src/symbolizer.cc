@@ -1,5 +1,6 @@
 #include "symbolizer.hh"
 
+#include <cstdio>
 #include <cstring>
 #include <cxxabi.h>
 #include <iostream>
@@ -32,17 +33,49 @@ Symbolizer::Symbolizer(bool verbose)
   dwfl_report_end(m_dwfl, nullptr, nullptr);
 
   if (success != 0) {
-    std::ostringstream oss;
-    oss << "error: failed to report process to dwfl. "
-        << dwfl_errmsg(dwfl_errno());
-    m_errmsg = oss.str();
+    report_failed();
+  }
+  return;
+}
+
+Symbolizer::Symbolizer(const std::string &maps, bool verbose)
+    : m_dwfl(dwfl_begin(&s_callbacks)), m_verbose(verbose) {
+
+  if (m_dwfl == nullptr) {
+    m_errmsg = "error: failed to initialize dwfl";
     if (m_verbose) {
       std::cerr << m_errmsg << std::endl;
     }
-    dwfl_end(m_dwfl);
-    m_dwfl = nullptr;
     return;
   }
+
+  FILE *maps_file =
+      fmemopen(const_cast<char *>(maps.data()), maps.size(), "r");
+  if (maps_file == nullptr) {
+    report_failed();
+    return;
+  }
+  dwfl_report_begin(m_dwfl);
+  int success = dwfl_linux_proc_maps_report(m_dwfl, maps_file);
+  dwfl_report_end(m_dwfl, nullptr, nullptr);
+  fclose(maps_file);
+
+  if (success != 0) {
+    report_failed();
+  }
+  return;
+}
+
+void Symbolizer::report_failed() {
+  std::ostringstream oss;
+  oss << "error: failed to report process to dwfl. "
+      << dwfl_errmsg(dwfl_errno());
+  m_errmsg = oss.str();
+  if (m_verbose) {
+    std::cerr << m_errmsg << std::endl;
+  }
+  dwfl_end(m_dwfl);
+  m_dwfl = nullptr;
   return;
 }
 
@@ -10,10 +10,20 @@ private:
   bool m_verbose;
   std::string m_errmsg;
 
+  /* Ends the dwfl session after a failure to report modules.
+   */
+  void report_failed();
+
 public:
   /* Setting 'verbose' to true will immediately print error messages to stderr.
    */
   Symbolizer(bool verbose=false);
+
+  /* Symbolizes addresses of another process from the lines of its
+   * /proc/<pid>/maps in 'maps' (see trace.hh). The binaries and libraries it
+   * names must be present at the same paths.
+   */
+  Symbolizer(const std::string &maps, bool verbose=false);
   ~Symbolizer();
 
   /* Given an instruction pointer for the running program, will return the
@@ -0,0 +1,193 @@
+#include "thread_log.hh"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <new>
+
+namespace {
+/* Registry of every thread log created during execution. Logs are only ever
+ * pushed onto the front of the list, so it can be traversed without a lock.
+ */
+std::atomic<thread_log_t *> s_thread_logs = nullptr;
+
+/* The calling thread's log. This is kept trivially destructible so that the
+ * fast path of get_thread_log() is a plain thread-local load.
+ */
+thread_local thread_log_t *t_thread_log = nullptr;
+// set once the calling thread has started exiting
+thread_local bool t_thread_exited = false;
+
+/* Retires the calling thread's log when the thread exits so that the log can
+ * be reused by threads created later on.
+ */
+struct thread_log_owner {
+  thread_log_t *log = nullptr;
+  ~thread_log_owner() {
+    t_thread_exited = true;
+    t_thread_log = nullptr;
+    if (log != nullptr) {
+      log->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+thread_local thread_log_owner t_thread_log_owner;
+
+/* Attempts to take ownership of the log of a thread that has exited. Returns
+ * nullptr if there is no such log.
+ */
+thread_log_t *adopt_retired_log() {
+  for (thread_log_t *log = s_thread_logs.load(std::memory_order_acquire);
+       log != nullptr; log = log->next) {
+    bool retired = true;
+    if (log->retired.load(std::memory_order_relaxed) &&
+        log->retired.compare_exchange_strong(retired, false,
+                                             std::memory_order_acquire)) {
+      return log;
+    }
+  }
+  return nullptr;
+}
+
+thread_log_t *register_thread_log() {
+  thread_log_t *log = adopt_retired_log();
+  if (log == nullptr) {
+    // Give each log its own cache line so that threads appending to their logs
+    // do not falsely share with each other.
+    void *mem = arena_alloc(sizeof(thread_log_t), 64);
+    log = (mem != nullptr) ? new (mem) thread_log_t() : new thread_log_t();
+    log->retired.store(false, std::memory_order_relaxed);
+    log->next = s_thread_logs.load(std::memory_order_relaxed);
+    while (!s_thread_logs.compare_exchange_weak(log->next, log,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+    }
+  }
+  if (!t_thread_exited) {
+    // An event reported while the thread is being torn down gets a log that
+    // is never retired, it is still merged at the end of execution.
+    t_thread_log_owner.log = log;
+    t_thread_log = log;
+  }
+  return log;
+}
+} // namespace
+
+thread_log_t *get_thread_log() {
+  thread_log_t *log = t_thread_log;
+  if (log == nullptr) [[unlikely]] {
+    log = register_thread_log();
+  }
+  return log;
+}
+
+void merge_thread_logs(std::pmr::vector<target_info_t> *target_log_ptr,
+                       std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                       std::pmr::vector<kernel_info_t> *kernel_log_ptr) {
+  size_t num_targets = target_log_ptr->size();
+  size_t num_data_ops = data_op_log_ptr->size();
+  size_t num_kernels = kernel_log_ptr->size();
+  for (thread_log_t *log = s_thread_logs.load(std::memory_order_acquire);
+       log != nullptr; log = log->next) {
+    num_targets += log->target_log.size();
+    num_data_ops += log->data_op_log.size();
+    num_kernels += log->kernel_log.size();
+  }
+  target_log_ptr->reserve(num_targets);
+  data_op_log_ptr->reserve(num_data_ops);
+  kernel_log_ptr->reserve(num_kernels);
+
+  // device trace records may be delivered on any thread, so they are all
+  // gathered before the kernels are merged
+  std::unordered_map<uint64_t /*host_op_id*/,
+                     std::chrono::duration<uint64_t, std::nano>>
+      exec_times;
+  for (thread_log_t *log = s_thread_logs.load(std::memory_order_acquire);
+       log != nullptr; log = log->next) {
+    log->kernel_exec_log.for_each([&exec_times](const kernel_exec_t &entry) {
+      exec_times.emplace(entry.host_op_id, entry.exec_time);
+    });
+    log->kernel_exec_log.release();
+  }
+
+  for (thread_log_t *log = s_thread_logs.load(std::memory_order_acquire);
+       log != nullptr; log = log->next) {
+    log->target_log.for_each([target_log_ptr](const target_info_t &entry) {
+      target_log_ptr->push_back(entry);
+    });
+    log->data_op_log.for_each([data_op_log_ptr](const data_op_info_t &entry) {
+      data_op_log_ptr->push_back(entry);
+    });
+    log->kernel_log.for_each(
+        [kernel_log_ptr, &exec_times](const kernel_info_t &entry) {
+          kernel_log_ptr->push_back(entry);
+          const auto it = exec_times.find(entry.host_op_id);
+          if (it != exec_times.end()) {
+            kernel_log_ptr->back().exec_time = it->second;
+          }
+        });
+    // release the memory held by the per-thread copy
+    log->target_log.release();
+    log->data_op_log.release();
+    log->kernel_log.release();
+  }
+  return;
+}
+
+void get_thread_logs_bytes(size_t *event_bytes_ptr,
+                           size_t *resident_bytes_ptr) {
+  size_t event_bytes = 0;
+  size_t resident_bytes = 0;
+  for (thread_log_t *log = s_thread_logs.load(std::memory_order_acquire);
+       log != nullptr; log = log->next) {
+    event_bytes += log->target_log.size() * sizeof(target_info_t);
+    event_bytes += log->data_op_log.encoded_bytes();
+    event_bytes += log->kernel_log.size() * sizeof(kernel_info_t);
+    event_bytes += log->kernel_exec_log.size() * sizeof(kernel_exec_t);
+    resident_bytes += log->target_log.resident_bytes();
+    resident_bytes += log->data_op_log.resident_bytes();
+    resident_bytes += log->kernel_log.resident_bytes();
+    resident_bytes += log->kernel_exec_log.resident_bytes();
+  }
+  *event_bytes_ptr = event_bytes;
+  *resident_bytes_ptr = resident_bytes;
+  return;
+}
+
+void merge_thread_site_stats(
+    std::vector<data_op_site_stats_t> *site_stats_ptr) {
+  std::map<data_op_site_t, data_op_site_stats_t> merged;
+  for (thread_log_t *log = s_thread_logs.load(std::memory_order_acquire);
+       log != nullptr; log = log->next) {
+    for (const auto &[site, entry] : log->site_log) {
+      if (entry.stats.calls == 0) {
+        // transfers began on this thread but ended on another one
+        continue;
+      }
+      const auto [it, inserted] = merged.emplace(site, entry.stats);
+      if (!inserted) {
+        data_op_site_stats_t &stats = it->second;
+        stats.calls += entry.stats.calls;
+        stats.bytes += entry.stats.bytes;
+        stats.time += entry.stats.time;
+        stats.min_time = std::min(stats.min_time, entry.stats.min_time);
+        stats.max_time = std::max(stats.max_time, entry.stats.max_time);
+      }
+    }
+    log->site_log.clear();
+  }
+
+  site_stats_ptr->reserve(site_stats_ptr->size() + merged.size());
+  for (const auto &[site, stats] : merged) {
+    site_stats_ptr->push_back(stats);
+  }
+  return;
+}
+
+void merge_thread_profiles(tool_profile_t &profile) {
+  for (thread_log_t *log = s_thread_logs.load(std::memory_order_acquire);
+       log != nullptr; log = log->next) {
+    profile_merge(profile, log->profile);
+  }
+  return;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analyze.hh"
+#include "arena.hh"
+#include "packed_log.hh"
+#include "self_profile.hh"
+
+/* Identifies the data ops of one type issued from one call site.
+ */
+typedef std::pair<const void * /*codeptr_ra*/, ompt_target_data_op_t>
+    data_op_site_t;
+
+struct data_op_site_hash {
+  size_t operator()(const data_op_site_t &site) const {
+    return std::hash<const void *>()(site.first) ^
+           (static_cast<size_t>(site.second) << 1);
+  }
+};
+
+/* Per-thread state of a call site when its statistics are kept as the
+ * program runs (see keep_site_stats()), i.e. when transfers are sampled and in
+ * online and counters only modes. Durations are raw (see ToolClock) until the
+ * logs are merged.
+ */
+typedef struct site_log {
+  data_op_site_stats_t stats;
+  // number of transfers from this site that began on this thread, used to
+  // pick which transfers are sampled
+  uint64_t begun;
+} site_log_t;
+
+/* Execution time of a kernel traced on its device (see device_trace.hh),
+ * matched to its kernel_info_t through 'host_op_id' when the logs are merged.
+ */
+typedef struct kernel_exec {
+  uint64_t host_op_id;
+  std::chrono::duration<uint64_t, std::nano> exec_time;
+} kernel_exec_t;
+
+/* Per-thread event log. Every thread that reports a target event appends to
+ * its own log without any synchronization. Logs are allocated from the arena
+ * and owned by a global registry rather than by the thread, so they remain
+ * valid after the thread that filled them exits and can be merged once the
+ * user's program has completed.
+ */
+typedef struct thread_log {
+  ChunkedLog<target_info_t> target_log;
+  PackedDataOpLog data_op_log;
+  ChunkedLog<kernel_info_t> kernel_log;
+  // filled by the threads the runtime delivers device trace buffers on
+  ChunkedLog<kernel_exec_t> kernel_exec_log;
+  // only used when the call site statistics are kept as the program runs,
+  // they cover every data op whereas the data op log holds at most the sampled
+  // transfers, allocated from the arena
+  std::pmr::unordered_map<data_op_site_t, site_log_t, data_op_site_hash>
+      site_log = decltype(site_log)(arena_resource());
+  // only used when self-profiling
+  tool_profile_t profile;
+  // set once the owning thread has exited, the log may then be adopted by a
+  // new thread
+  std::atomic<bool> retired;
+  // next log in the registry
+  thread_log *next;
+} thread_log_t;
+
+/* Returns the calling thread's log. The first call on each thread registers a
+ * log (or adopts the log of a thread that has since exited), subsequent calls
+ * are a single thread-local load.
+ */
+thread_log_t *get_thread_log();
+
+/* Moves the contents of every registered thread log into the given logs, and
+ * sets the execution time of the kernels traced on their device. Must only be
+ * called once no other thread can report target events or device traces. The
+ * log headers themselves are never freed since threads that are still alive
+ * will retire their log when they exit.
+ */
+void merge_thread_logs(std::pmr::vector<target_info_t> *target_log_ptr,
+                       std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                       std::pmr::vector<kernel_info_t> *kernel_log_ptr);
+
+/* Stores in 'event_bytes_ptr' the number of bytes taken by the events held in
+ * every registered thread log, and in 'resident_bytes_ptr' the number of bytes
+ * of memory the logs hold for them. Events spilled to disk are not counted.
+ */
+void get_thread_logs_bytes(size_t *event_bytes_ptr,
+                           size_t *resident_bytes_ptr);
+
+/* Combines the call site statistics of every registered thread log into
+ * 'site_stats_ptr'. Must only be called once no other thread can report target
+ * events.
+ */
+void merge_thread_site_stats(
+    std::vector<data_op_site_stats_t> *site_stats_ptr);
+
+/* Combines the self-profile counters of every registered thread log into
+ * 'profile'. Must only be called once no other thread can report target
+ * events.
+ */
+void merge_thread_profiles(tool_profile_t &profile);
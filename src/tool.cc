@@ -1,13 +1,30 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <mutex>
 
 #include <omp-tools.h>
+#include <sched.h>
 
 #include "analyze.hh"
+#include "arena.hh"
+#include "clock.hh"
+#include "device_trace.hh"
+#include "hash_cache.hh"
+#include "hash_verify.hh"
+#include "hasher.hh"
+#include "op_table.hh"
+#include "self_profile.hh"
+#include "sparse_hash.hh"
+#include "stream_detector.hh"
 #include "symbolizer.hh"
+#include "thread_log.hh"
+#include "trace.hh"
 
 using namespace std::chrono;
 
@@ -17,37 +34,92 @@ namespace {
 steady_clock::time_point s_start_time;
 steady_clock::time_point s_end_time;
 
-/* As the user's program runs we log information about target operations to this
- * array which is analyzed once the execution of the user's program has
- * completed.
+/* As the user's program runs each thread logs information about target
+ * operations to its own thread log (see thread_log.hh). Once the execution of
+ * the user's program has completed the thread logs are merged into these
+ * arrays which are then analyzed.
+ */
+std::pmr::vector<target_info_t> *s_target_log_ptr;
+std::pmr::vector<data_op_info_t> *s_data_op_log_ptr;
+std::pmr::vector<kernel_info_t> *s_kernel_log_ptr;
+std::atomic<bool> s_event_dropped = false;
+
+/* Ids stored in the target_data of target constructs so that their data ops
+ * and kernels can be attributed to them. Zero means no target construct.
+ */
+std::atomic<uint64_t> s_next_target_id = 1;
+
+/* Maximum number of helper threads started by default to hash large
+ * transfers.
+ */
+constexpr int k_max_default_hash_threads = 4;
+
+/* Maximum number of asynchronous operations that can be in flight at once.
+ */
+constexpr size_t k_op_table_capacity = 1 << 16;
+std::atomic<bool> s_op_table_full = false;
+
+/* About 1 in 's_sample_period' data transfers is hashed and logged, every
+ * data op is timed regardless. With a period of 1 every transfer is logged and
+ * the per call site statistics are not kept.
+ */
+uint64_t s_sample_period = 1;
+bool s_sample_random = false;
+std::vector<data_op_site_stats_t> *s_site_stats_ptr;
+
+/* In online mode transfers are classified as they complete (see
+ * stream_detector.hh) instead of being logged, the per call site statistics
+ * are kept as with sampling.
+ */
+constexpr size_t k_default_online_entries = 1 << 18;
+bool s_online = false;
+
+/* In counters only mode nothing is hashed or logged, data ops are only timed
+ * and accounted for in the statistics of their call site, and target regions
+ * and kernels are not traced.
+ */
+bool s_counters = false;
+
+// width of the hash function picked by OMPDATAPERF_HASH=auto unless
+// OMPDATAPERF_HASH_BITS says otherwise, 32 bit fingerprints collide too often
+constexpr unsigned int k_default_hash_bits = 64;
+
+// buffers at least this large are hashed without polluting the caches unless
+// OMPDATAPERF_STREAMING_HASH says otherwise (see hasher.hh)
+constexpr size_t k_default_streaming_hash_bytes = 32 * 1024 * 1024;
+
+// transfers of at least this many bytes are fingerprinted sparsely (see
+// sparse_hash.hh), 0 if disabled
+size_t s_sparse_hash_bytes = 0;
+
+/* If set, the event logs are written to a trace file that can be analyzed
+ * later on by ompdataperf-analyze (see trace.hh). With 's_trace_only' the
+ * analysis is not run in the profiled process at all.
  */
-std::vector<target_info_t> *s_target_log_ptr;
-std::mutex s_target_log_mutex;
-std::vector<data_op_info_t> *s_data_op_log_ptr;
-std::mutex s_data_op_log_mutex;
+const char *s_trace_path = nullptr;
+bool s_trace_only = false;
 
-#ifdef ENABLE_COLLISION_CHECKING
-std::map<HASH_T, std::set<data_info_t>> *s_collision_map_ptr;
+/* Optional modes, set at startup through environment variables (see
+ * init_modes()). Modes that add work to the callbacks select which variant of
+ * the callbacks is registered, so that they cost nothing when disabled.
+ */
+// the data of transfers is kept to count hash collisions exactly, for about 1
+// in s_collision_check_period fingerprints
+bool s_check_collisions = false;
+uint64_t s_collision_check_period = 1;
+std::map<HASH_T, std::set<data_info_t>> *s_collision_map_ptr = nullptr;
 std::mutex s_collision_map_mutex;
-#endif // ENABLE_COLLISION_CHECKING
-
-#ifdef MEASURE_HASHING_OVERHEAD
-duration<uint64_t, std::nano> s_hash_overhead;
-std::mutex s_hash_overhead_mutex;
-
-HASH_T hash_fn_measure(void *key, size_t len) {
-  steady_clock::time_point start_time = steady_clock::now();
-  HASH_T hash = HASH_FN(key, len);
-  steady_clock::time_point end_time = steady_clock::now();
-  duration<uint64_t, std::nano> overhead = end_time - start_time;
-  s_hash_overhead_mutex.lock();
-  s_hash_overhead += overhead;
-  s_hash_overhead_mutex.unlock();
-  return hash;
-}
-#undef HASH_FN
-#define HASH_FN(key, len) hash_fn_measure(key, len)
-#endif // MEASURE_HASHING_OVERHEAD
+// fingerprints are verified with a second hash function (see hash_verify.hh)
+bool s_verify_hashes = false;
+// the overhead of the tool itself is profiled (see self_profile.hh)
+bool s_self_profile = false;
+steady_clock::time_point s_profile_start_time;
+// the hashing overhead is printed, taken from the self-profile counters
+bool s_measure_hashing = false;
+bool s_print_space_overhead = false;
+bool s_print_transfer_rate = false;
+// info messages about the setup of the tool are printed (ompdataperf -v)
+bool s_verbose = false;
 
 /* Binding Entry Points in the OMPT Callback Interface
  */
@@ -70,9 +142,509 @@ ompt_get_num_devices_t ompt_get_num_devices;
 ompt_get_unique_id_t ompt_get_unique_id;
 ompt_finalize_tool_t ompt_finalize_tool;
 ompt_function_lookup_t ompt_function_lookup;
+
+/* Prints a warning the first time an event cannot be logged because the event
+ * log could not be grown.
+ */
+void warn_event_dropped() {
+  if (!s_event_dropped.exchange(true, std::memory_order_relaxed)) {
+    std::cerr << "warning: event log is out of memory. Events are being "
+                 "dropped and results will be incomplete.\n";
+  }
+  return;
+}
+
+/* Times the phases of a callback for the self-profile. Compiles to nothing
+ * unless 'Enabled'. The whole callback is accounted for when the profiler goes
+ * out of scope.
+ */
+template <bool Enabled> class CallbackProfiler {
+private:
+  tool_profile_t *m_profile = nullptr;
+  steady_clock::time_point m_start;
+  steady_clock::time_point m_phase_start;
+
+public:
+  explicit CallbackProfiler(steady_clock::time_point start) {
+    if constexpr (Enabled) {
+      m_profile = &get_thread_log()->profile;
+      m_start = start;
+      // the cost of a timestamp is that of two reads back to back
+      const steady_clock::time_point before = ToolClock::now();
+      m_phase_start = ToolClock::now();
+      profile_record(*m_profile, k_phase_timestamp, m_phase_start - before);
+    }
+  }
+
+  ~CallbackProfiler() {
+    if constexpr (Enabled) {
+      const steady_clock::time_point end = ToolClock::now();
+      profile_record(*m_profile, k_phase_callback, end - m_start);
+      if (m_profile->calls[k_phase_callback] % k_profile_memory_period == 0) {
+        profile_sample_memory(end);
+      }
+    }
+  }
+
+  void begin_phase() {
+    if constexpr (Enabled) {
+      m_phase_start = ToolClock::now();
+    }
+  }
+
+  void end_phase(profile_phase_t phase) {
+    if constexpr (Enabled) {
+      profile_record(*m_profile, phase, ToolClock::now() - m_phase_start);
+    }
+  }
+
+  /* Ends a hash phase that hashed a transfer of 'bytes' bytes.
+   */
+  void end_hash(size_t bytes) {
+    if constexpr (Enabled) {
+      const steady_clock::duration raw = ToolClock::now() - m_phase_start;
+      profile_record(*m_profile, k_phase_hash, raw);
+      profile_record_hash(*m_profile, bytes, raw);
+    }
+  }
+};
+
+/* Returns true if the environment variable 'name' is set to a value other
+ * than "0", false otherwise.
+ */
+bool getenv_bool(const char *name) {
+  const char *value = getenv(name);
+  return value != nullptr && strcmp(value, "0") != 0;
+}
+
+/* Returns true if the environment variable 'name' is set to 'expected', false
+ * otherwise.
+ */
+bool getenv_str_equals(const char *name, const char *expected) {
+  const char *value = getenv(name);
+  return value != nullptr && strcmp(value, expected) == 0;
+}
+
+/* Reads a size in bytes from the environment variable 'name', optionally
+ * followed by a K, M or G suffix. Returns 0 if the variable is not set or is
+ * not a valid size.
+ */
+size_t getenv_bytes(const char *name) {
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return 0;
+  }
+  char *end = nullptr;
+  size_t bytes = strtoull(value, &end, 10);
+  switch (*end) {
+  case 'G':
+  case 'g':
+    bytes *= 1024;
+    [[fallthrough]];
+  case 'M':
+  case 'm':
+    bytes *= 1024;
+    [[fallthrough]];
+  case 'K':
+  case 'k':
+    bytes *= 1024;
+    ++end;
+    break;
+  default:
+    break;
+  }
+  if (end == value || *end != '\0') {
+    std::cerr << "warning: ignoring invalid " << name << " '" << value
+              << "'.\n";
+    return 0;
+  }
+  return bytes;
+}
+
+/* Sets up spilling of the event log to disk if a memory budget is given with
+ * OMPDATAPERF_MAX_MEMORY. The spill file is created in OMPDATAPERF_SPILL_DIR,
+ * or else in TMPDIR or /tmp.
+ */
+void init_spill() {
+  const size_t max_bytes = getenv_bytes("OMPDATAPERF_MAX_MEMORY");
+  if (max_bytes == 0) {
+    return;
+  }
+  const char *dir = getenv("OMPDATAPERF_SPILL_DIR");
+  if (dir == nullptr) {
+    dir = getenv("TMPDIR");
+  }
+  if (dir == nullptr) {
+    dir = "/tmp";
+  }
+  arena_init_spill(max_bytes, dir);
+  return;
+}
+
+/* Acquires a slot in the op table for an asynchronous operation and stores
+ * 'op' in it. Returns the handle to be passed back to end_async_op(), or 0 if
+ * the op table is full, in which case the background hash of 'op' (if any) is
+ * discarded.
+ */
+uint64_t begin_async_op(const op_state_t &op) {
+  op_slot_t *slot = nullptr;
+  const uint64_t handle = op_table_acquire(&slot);
+  if (handle == 0) {
+    if (!s_op_table_full.exchange(true, std::memory_order_relaxed)) {
+      std::cerr << "warning: too many asynchronous operations in flight. "
+                   "Some operations will be reported with zero duration.\n";
+    }
+    if (op.hash_task != nullptr) {
+      hash_buffer_end(op.hash_task);
+    }
+    return 0;
+  }
+  slot->op = op;
+  return handle;
+}
+
+/* Releases the op table slot of an asynchronous operation and returns the
+ * state stored by begin_async_op(). If 'handle' does not refer to an operation
+ * in flight, the operation is treated as starting at 'end_time'.
+ */
+op_state_t end_async_op(uint64_t handle, steady_clock::time_point end_time) {
+  op_slot_t *slot = op_table_lookup(handle);
+  if (slot == nullptr) {
+    return {end_time, nullptr, true, false, 0};
+  }
+  const op_state_t op = slot->op;
+  op_table_release(slot);
+  return op;
+}
+
+/* Returns true if the transfer from 'codeptr_ra' that is beginning on the
+ * calling thread should be hashed and logged. Transfers from each call site are
+ * sampled either periodically or at random, in both cases about 1 in
+ * 's_sample_period' of them.
+ */
+bool sample_transfer(const void *codeptr_ra, ompt_target_data_op_t optype) {
+  if (s_sample_random) {
+    // xorshift64*, seeded differently on each thread
+    static thread_local uint64_t t_rng_state =
+        0x9e3779b97f4a7c15ull ^ reinterpret_cast<uintptr_t>(&t_rng_state);
+    t_rng_state ^= t_rng_state >> 12;
+    t_rng_state ^= t_rng_state << 25;
+    t_rng_state ^= t_rng_state >> 27;
+    return (t_rng_state * 0x2545f4914f6cdd1dull) % s_sample_period == 0;
+  }
+  site_log_t &site = get_thread_log()->site_log[{codeptr_ra, optype}];
+  return site.begun++ % s_sample_period == 0;
+}
+
+/* Returns true if the statistics of each call site are kept as the program
+ * runs rather than derived from the data op log.
+ */
+bool keep_site_stats() {
+  return s_sample_period > 1 || s_online || s_counters;
+}
+
+/* Accounts for a data op in the exact statistics of its call site. Only used
+ * when keep_site_stats() is true.
+ */
+void record_site_stats(const void *codeptr_ra, ompt_target_data_op_t optype,
+                       size_t bytes, duration<uint64_t, std::nano> time) {
+  data_op_site_stats_t &stats =
+      get_thread_log()->site_log[{codeptr_ra, optype}].stats;
+  if (stats.calls == 0) {
+    stats.codeptr_ra = codeptr_ra;
+    stats.optype = optype;
+    stats.min_time = time;
+    stats.max_time = time;
+  }
+  stats.calls += 1;
+  stats.bytes += bytes;
+  stats.time += time;
+  stats.min_time = std::min(stats.min_time, time);
+  stats.max_time = std::max(stats.max_time, time);
+  return;
+}
+
+/* Returns true if transfers of 'bytes' bytes to a device are hashed through
+ * the hash cache.
+ */
+bool use_hash_cache(size_t bytes) {
+  return bytes >= k_hash_cache_min_bytes && hash_cache_enabled();
+}
+
+/* Returns true if transfers of 'bytes' bytes are fingerprinted sparsely.
+ */
+bool use_sparse_hash(size_t bytes) {
+  return s_sparse_hash_bytes != 0 && bytes >= s_sparse_hash_bytes;
+}
+
+/* Reads the sparse fingerprint threshold from OMPDATAPERF_SPARSE_HASH.
+ */
+void init_sparse_hash() {
+  s_sparse_hash_bytes = getenv_bytes("OMPDATAPERF_SPARSE_HASH");
+  if (s_sparse_hash_bytes == 0) {
+    return;
+  }
+  if (s_sparse_hash_bytes < k_sparse_hash_min_bytes) {
+    std::cerr << "warning: buffers smaller than " << k_sparse_hash_min_bytes
+              << " bytes are always hashed in full.\n";
+    s_sparse_hash_bytes = k_sparse_hash_min_bytes;
+  }
+  sparse_hash_init();
+  return;
+}
+
+/* Reads the minimum width of the hash function picked by OMPDATAPERF_HASH=auto
+ * from OMPDATAPERF_HASH_BITS.
+ */
+unsigned int getenv_hash_bits() {
+  const char *value = getenv("OMPDATAPERF_HASH_BITS");
+  if (value == nullptr) {
+    return k_default_hash_bits;
+  }
+  char *end = nullptr;
+  const unsigned long bits = strtoul(value, &end, 10);
+  const bool valid = end != value && *end == '\0';
+  if (valid && (bits == 32 || bits == 64 || bits == 128)) {
+    return bits;
+  }
+  std::cerr << "warning: ignoring invalid OMPDATAPERF_HASH_BITS '" << value
+            << "', expected 32, 64 or 128.\n";
+  return k_default_hash_bits;
+}
+
+/* Reads the streaming hash threshold from OMPDATAPERF_STREAMING_HASH, where 0
+ * disables streaming.
+ */
+void init_streaming_hash() {
+  size_t min_bytes = k_default_streaming_hash_bytes;
+  if (getenv("OMPDATAPERF_STREAMING_HASH") != nullptr) {
+    min_bytes = getenv_bytes("OMPDATAPERF_STREAMING_HASH");
+  }
+  hash_streaming_init(min_bytes);
+  return;
+}
+
+/* Reads the sampling configuration from OMPDATAPERF_SAMPLE_PERIOD and
+ * OMPDATAPERF_SAMPLE_RANDOM.
+ */
+void init_sampling() {
+  const char *env_sample_period = getenv("OMPDATAPERF_SAMPLE_PERIOD");
+  if (env_sample_period != nullptr) {
+    const long long period = atoll(env_sample_period);
+    if (period < 1) {
+      std::cerr << "warning: ignoring invalid OMPDATAPERF_SAMPLE_PERIOD '"
+                << env_sample_period << "'.\n";
+    } else {
+      s_sample_period = period;
+    }
+  }
+  s_sample_random = getenv_bool("OMPDATAPERF_SAMPLE_RANDOM");
+  return;
+}
+
+/* Reads the online mode configuration from OMPDATAPERF_ONLINE and
+ * OMPDATAPERF_ONLINE_ENTRIES.
+ */
+void init_online() {
+  s_online = getenv_bool("OMPDATAPERF_ONLINE");
+  if (!s_online) {
+    return;
+  }
+  if (s_sample_period > 1) {
+    std::cerr << "warning: sampling is not supported in online mode, every "
+                 "transfer will be analyzed.\n";
+    s_sample_period = 1;
+  }
+  size_t entries = k_default_online_entries;
+  const char *env_online_entries = getenv("OMPDATAPERF_ONLINE_ENTRIES");
+  if (env_online_entries != nullptr) {
+    const long long value = atoll(env_online_entries);
+    if (value < 1) {
+      std::cerr << "warning: ignoring invalid OMPDATAPERF_ONLINE_ENTRIES '"
+                << env_online_entries << "'.\n";
+    } else {
+      entries = value;
+    }
+  }
+  stream_init(entries);
+  return;
+}
+
+/* Warns about the settings that have no effect in counters only mode, as they
+ * need the data to be hashed or the events to be logged, if they are set to
+ * anything but a value that disables them. These are the settings that are
+ * not read at all in this mode.
+ */
+void init_counters() {
+  // on unless set to 0
+  const char *ignored_bools[] = {"OMPDATAPERF_ONLINE",
+                                 "OMPDATAPERF_TRACE_ONLY",
+                                 "OMPDATAPERF_SAMPLE_RANDOM",
+                                 "OMPDATAPERF_HASH_CACHE",
+                                 "OMPDATAPERF_CHECK_COLLISIONS",
+                                 "OMPDATAPERF_VERIFY_HASHES",
+                                 "OMPDATAPERF_MEASURE_HASHING",
+                                 "OMPDATAPERF_PRINT_SPACE_OVERHEAD",
+                                 "OMPDATAPERF_PRINT_TRANSFER_RATE"};
+  // sizes, 0 disables them
+  const char *ignored_sizes[] = {"OMPDATAPERF_SPARSE_HASH",
+                                 "OMPDATAPERF_STREAMING_HASH"};
+  // counts, with the smallest one that has an effect
+  const std::pair<const char *, long long> ignored_counts[] = {
+      {"OMPDATAPERF_SAMPLE_PERIOD", 2},
+      {"OMPDATAPERF_ONLINE_ENTRIES", 1},
+      {"OMPDATAPERF_CHECK_COLLISIONS_PERIOD", 1},
+      {"OMPDATAPERF_HASH_THREADS", 1}};
+  // anything but empty
+  const char *ignored_strings[] = {"OMPDATAPERF_TRACE", "OMPDATAPERF_HASH",
+                                   "OMPDATAPERF_HASH_BITS"};
+
+  const auto warn = [](const char *name) {
+    std::cerr << "warning: " << name << " is ignored in counters only mode.\n";
+  };
+  for (const char *name : ignored_bools) {
+    if (getenv_bool(name)) {
+      warn(name);
+    }
+  }
+  for (const char *name : ignored_sizes) {
+    if (getenv_bytes(name) != 0) {
+      warn(name);
+    }
+  }
+  for (const auto &[name, min_count] : ignored_counts) {
+    const char *value = getenv(name);
+    if (value != nullptr && atoll(value) >= min_count) {
+      warn(name);
+    }
+  }
+  for (const char *name : ignored_strings) {
+    const char *value = getenv(name);
+    if (value != nullptr && value[0] != '\0') {
+      warn(name);
+    }
+  }
+  return;
+}
+
+/* Reads the optional modes from OMPDATAPERF_COUNTERS,
+ * OMPDATAPERF_CHECK_COLLISIONS, OMPDATAPERF_CHECK_COLLISIONS_PERIOD,
+ * OMPDATAPERF_VERIFY_HASHES, OMPDATAPERF_SELF_PROFILE,
+ * OMPDATAPERF_MEASURE_HASHING, OMPDATAPERF_PRINT_SPACE_OVERHEAD,
+ * OMPDATAPERF_PRINT_TRANSFER_RATE and OMPDATAPERF_VERBOSE.
+ */
+void init_modes() {
+  s_counters = getenv_bool("OMPDATAPERF_COUNTERS");
+  if (s_counters) {
+    init_counters();
+  }
+  s_check_collisions =
+      !s_counters && getenv_bool("OMPDATAPERF_CHECK_COLLISIONS");
+  const char *env_check_period = getenv("OMPDATAPERF_CHECK_COLLISIONS_PERIOD");
+  if (!s_counters && env_check_period != nullptr) {
+    const long long period = atoll(env_check_period);
+    if (period < 1) {
+      std::cerr << "warning: ignoring invalid "
+                   "OMPDATAPERF_CHECK_COLLISIONS_PERIOD '"
+                << env_check_period << "'.\n";
+    } else {
+      s_collision_check_period = period;
+      s_check_collisions = true;
+    }
+  }
+  if (s_check_collisions && s_collision_check_period > 1) {
+    std::cerr << "info: checking about 1 in " << s_collision_check_period
+              << " fingerprints for hash collisions.\n";
+  } else if (s_check_collisions) {
+    std::cerr << "warning: hash collision checking keeps a copy of all "
+                 "transferred data, profiling will be much slower and use "
+                 "much more memory.\n";
+  }
+  if (s_check_collisions) {
+    s_collision_map_ptr = new std::map<HASH_T, std::set<data_info_t>>();
+  }
+  s_verify_hashes = !s_counters && getenv_bool("OMPDATAPERF_VERIFY_HASHES");
+  s_self_profile = getenv_bool("OMPDATAPERF_SELF_PROFILE");
+  s_measure_hashing =
+      !s_counters && getenv_bool("OMPDATAPERF_MEASURE_HASHING");
+  profile_init(s_self_profile || s_measure_hashing);
+  s_print_space_overhead =
+      !s_counters && getenv_bool("OMPDATAPERF_PRINT_SPACE_OVERHEAD");
+  s_print_transfer_rate =
+      !s_counters && getenv_bool("OMPDATAPERF_PRINT_TRANSFER_RATE");
+  s_verbose = getenv_bool("OMPDATAPERF_VERBOSE");
+  return;
+}
+
+/* Returns the cpus this process is allowed to run on that do not belong to any
+ * OpenMP place, so that helper threads do not compete with the application's
+ * OpenMP threads. If the runtime does not report any places, 'places_known' is
+ * set to false and every allowed cpu is returned.
+ */
+std::vector<int> get_helper_cpus(bool *places_known) {
+  std::vector<int> cpus;
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    *places_known = false;
+    return cpus;
+  }
+
+  const int num_places = ompt_get_num_places();
+  *places_known = num_places > 0;
+  for (int place = 0; place < num_places; ++place) {
+    const int num_ids = ompt_get_place_proc_ids(place, 0, nullptr);
+    if (num_ids <= 0) {
+      continue;
+    }
+    std::vector<int> ids(num_ids);
+    ompt_get_place_proc_ids(place, num_ids, ids.data());
+    for (int id : ids) {
+      if (id >= 0 && id < CPU_SETSIZE) {
+        CPU_CLR(id, &allowed);
+      }
+    }
+  }
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+/* Starts the helper threads used to hash large transfers. The number of
+ * helpers may be set with OMPDATAPERF_HASH_THREADS, by default one helper is
+ * started per cpu outside of the OpenMP places (up to a limit).
+ */
+void start_hash_pool() {
+  bool places_known = false;
+  std::vector<int> cpus = get_helper_cpus(&places_known);
+  int num_threads;
+  const char *env_hash_threads = getenv("OMPDATAPERF_HASH_THREADS");
+  if (env_hash_threads != nullptr) {
+    num_threads = std::max(0, atoi(env_hash_threads));
+  } else if (places_known) {
+    num_threads = std::min<int>(k_max_default_hash_threads, cpus.size());
+  } else {
+    // leave at least one cpu to the application
+    num_threads =
+        std::min<int>(k_max_default_hash_threads, (int)cpus.size() - 1);
+  }
+  if (!places_known) {
+    // without places there is no telling which cpus the application uses,
+    // so let the scheduler place the helpers
+    cpus.clear();
+  } else if (cpus.empty() && num_threads > 0) {
+    std::cerr << "warning: every cpu belongs to an OpenMP place. Hashing "
+                 "helper threads will share cpus with the application.\n";
+  }
+  hash_pool_init(std::max(0, num_threads), cpus);
+  return;
+}
 } // namespace
 
-#ifdef ENABLE_COLLISION_CHECKING
 /* This function will try to insert a copy of data in the corresponding set in
  * the collision map.
  * It is the caller's responsibility to call 'free' on data.
@@ -103,40 +675,68 @@ void try_collision_map_insert(
   set.emplace_hint(hint, new_key);
   return;
 }
-#endif // ENABLE_COLLISION_CHECKING
 
+/* Checks 'hash', the fingerprint of the 'bytes' bytes starting at 'data', for
+ * collisions in the enabled ways.
+ */
+static void check_collisions(const HASH_T &hash, void *data, size_t bytes) {
+  if (s_verify_hashes) {
+    hash_verify(hash, data, bytes);
+  }
+  if (!s_check_collisions) {
+    return;
+  }
+  // Sampling by fingerprint keeps every buffer sharing a sampled fingerprint,
+  // which are the ones that may collide.
+  if (fingerprint_mix(hash) % s_collision_check_period != 0) {
+    return;
+  }
+  s_collision_map_mutex.lock();
+  try_collision_map_insert(s_collision_map_ptr, hash, data, bytes);
+  s_collision_map_mutex.unlock();
+  return;
+}
+
+/* The callbacks are instantiated for every combination of the modes that add
+ * work to them, and the instantiation matching the enabled modes is registered
+ * (see register_callbacks()).
+ */
+template <bool Profile>
 static void on_ompt_callback_target_emi(ompt_target_t kind,
                                         ompt_scope_endpoint_t endpoint,
                                         int device_num, ompt_data_t *task_data,
                                         ompt_data_t *target_task_data,
                                         ompt_data_t *target_data,
                                         const void *codeptr_ra) {
-  static thread_local uint64_t id = 0;
-  // used to time synchronous data op
+  // used to time synchronous target regions
   static thread_local steady_clock::time_point s_sync_target_start_time =
       steady_clock::time_point();
-  // used to time asynchronous data op
-  static thread_local std::map<uint64_t /*id*/,
-                               steady_clock::time_point /*start_time*/>
-      s_async_target_start_times;
 
   if (!is_target_exec(kind)) {
+    // data ops of other constructs are not attributed to a target region
+    if (endpoint == ompt_scope_begin && target_data != nullptr) {
+      target_data->value = 0;
+    }
     return;
   }
 
-  const steady_clock::time_point time_now = steady_clock::now();
+  const steady_clock::time_point time_now = ToolClock::now();
+  CallbackProfiler<Profile> profiler(time_now);
 
   bool is_async = is_async_target_exec(kind);
   if (endpoint == ompt_scope_begin) {
+    // the data ops and kernels of the construct are attributed to it by the
+    // id stored in its target_data
+    if (target_data != nullptr) {
+      target_data->value =
+          s_next_target_id.fetch_add(1, std::memory_order_relaxed);
+    }
     // commit start timestamp
-    s_sync_target_start_time = time_now;
     if (is_async) {
-      assert((target_task_data != nullptr && target_task_data->value == 0) &&
-             !s_async_target_start_times.contains(id));
+      assert(target_task_data != nullptr && target_task_data->value == 0);
       if (target_task_data != nullptr) {
-        target_task_data->value = id;
-        s_async_target_start_times[id] = time_now;
-        ++id;
+        target_task_data->value =
+            begin_async_op({time_now, nullptr, true, false, 0});
       }
     } else {
       s_sync_target_start_time = time_now;
@@ -146,100 +746,334 @@ static void on_ompt_callback_target_emi(ompt_target_t kind,
     // commit end timestamp
     steady_clock::time_point start_time;
     if (is_async) {
-      assert((target_task_data != nullptr) &&
-             s_async_target_start_times.contains(target_task_data->value));
-      if (target_task_data != nullptr) {
-        start_time = s_async_target_start_times[target_task_data->value];
-        s_async_target_start_times.erase(target_task_data->value);
-      }
+      assert(target_task_data != nullptr);
+      start_time =
+          end_async_op(
+              target_task_data != nullptr ? target_task_data->value : 0,
+              time_now)
+              .start_time;
     } else {
       start_time = s_sync_target_start_time;
     }
-    s_target_log_mutex.lock();
-    s_target_log_ptr->emplace_back(kind, device_num, start_time, time_now);
-    s_target_log_mutex.unlock();
+    const uint64_t target_id = target_data != nullptr ? target_data->value : 0;
+    profiler.begin_phase();
+    if (!get_thread_log()->target_log.emplace_back(
+            kind, device_num, target_id, codeptr_ra, start_time, time_now)) {
+      warn_event_dropped();
+    }
+    profiler.end_phase(k_phase_log);
   }
 
   return;
 }
 
+template <bool Profile, bool CheckCollisions>
 static void on_ompt_callback_target_data_op_emi(
     ompt_scope_endpoint_t endpoint, ompt_data_t *target_task_data,
     ompt_data_t *target_data, ompt_id_t *host_op_id,
     ompt_target_data_op_t optype, void *src_addr, int src_device_num,
     void *dest_addr, int dest_device_num, size_t bytes,
     const void *codeptr_ra) {
-  // used to time synchronous data op
-  static thread_local steady_clock::time_point s_sync_data_op_start_time =
-      steady_clock::time_point();
-  // used to time asynchronous data op
-  static thread_local std::map<
-      std::pair<int /*dest_device_num*/, const void * /*dest_addr*/>,
-      steady_clock::time_point /*start_time*/>
-      s_async_data_op_start_times;
+  // state of the synchronous data op in flight
+  static thread_local op_state_t s_sync_data_op = {
+      steady_clock::time_point(), nullptr, true, false, 0};
 
   if (!(is_transfer_op(optype) || is_alloc_op(optype) ||
         is_delete_op(optype))) {
     return;
   }
 
-  const steady_clock::time_point time_now = steady_clock::now();
+  const steady_clock::time_point time_now = ToolClock::now();
+  CallbackProfiler<Profile> profiler(time_now);
 
   bool is_async = is_async_op(optype);
 
   if (endpoint == ompt_scope_begin) {
+    op_state_t op = {time_now, nullptr, true, false, 0};
+    if (s_sample_period > 1 && is_transfer_op(optype)) {
+      op.sampled = sample_transfer(codeptr_ra, optype);
+    }
+    // The source of a transfer to the device is only read while the transfer
+    // is in flight, so large buffers are hashed by the helper threads in the
+    // meantime instead of after the transfer has completed. Constant buffers
+    // are not hashed, and buffers handled by the hash cache are mostly not
+    // rehashed at all.
+    if (op.sampled && is_transfer_to_op(optype) && src_addr != nullptr &&
+        bytes > k_inline_payload_bytes) {
+      profiler.begin_phase();
+      op.constant = find_constant_pattern(src_addr, bytes, op.pattern);
+      if (!op.constant && !use_hash_cache(bytes) && !use_sparse_hash(bytes)) {
+        op.hash_task = hash_buffer_begin(src_addr, bytes);
+      }
+      profiler.end_phase(k_phase_hash);
+    }
+
     // commit start timestamp
-    s_sync_data_op_start_time = time_now;
     if (is_async) {
-      const std::pair<int, const void *> key(dest_device_num, dest_addr);
-      assert(!s_async_data_op_start_times.contains(key));
-      s_async_data_op_start_times[key] = time_now;
+      assert(host_op_id != nullptr);
+      if (host_op_id != nullptr) {
+        *host_op_id = begin_async_op(op);
+      } else if (op.hash_task != nullptr) {
+        hash_buffer_end(op.hash_task);
+      }
     } else {
-      s_sync_data_op_start_time = time_now;
+      assert(s_sync_data_op.hash_task == nullptr);
+      s_sync_data_op = op;
     }
 
   } else if (endpoint == ompt_scope_end) {
     // commit end timestamp
+    op_state_t op;
+    if (is_async) {
+      assert(host_op_id != nullptr);
+      op = end_async_op(host_op_id != nullptr ? *host_op_id : 0, time_now);
+    } else {
+      op = s_sync_data_op;
+      s_sync_data_op.hash_task = nullptr;
+    }
+    const steady_clock::time_point start_time = op.start_time;
+
+    if (keep_site_stats()) {
+      record_site_stats(codeptr_ra, optype, bytes, time_now - start_time);
+    }
+    if (is_transfer_from_op(optype) && hash_cache_enabled()) {
+      // the transfer may have written the host buffer without setting the
+      // soft-dirty bits of its pages
+      hash_cache_invalidate(dest_addr, bytes);
+    }
+    // online mode keeps no event log, allocations and deletions are only
+    // accounted for in the statistics of their call site
+    if (!op.sampled || (s_online && !is_transfer_op(optype))) {
+      return;
+    }
+    const uint64_t target_id = target_data != nullptr ? target_data->value : 0;
+
     HASH_T hash = {};
-    if (is_transfer_to_op(optype)) {
+    profiler.begin_phase();
+    if (op.hash_task != nullptr) {
+      hash = hash_buffer_end(op.hash_task);
+    } else if (is_transfer_to_op(optype)) {
       assert(src_addr != nullptr);
       assert(dest_addr != nullptr);
-      hash = HASH_FN(src_addr, bytes);
+      if (bytes <= k_inline_payload_bytes) {
+        hash = inline_payload(src_addr, bytes);
+      } else if (op.constant) {
+        hash = constant_fingerprint(op.pattern);
+      } else if (use_sparse_hash(bytes)) {
+        hash = sparse_hash_buffer(src_addr, bytes);
+      } else if (use_hash_cache(bytes)) {
+        hash = hash_cache_hash(src_addr, bytes);
+      } else {
+        hash = hash_buffer(src_addr, bytes);
+      }
     } else if (is_transfer_from_op(optype)) {
       assert(src_addr != nullptr);
       assert(dest_addr != nullptr);
-      hash = HASH_FN(dest_addr, bytes);
+      uint64_t pattern;
+      if (bytes <= k_inline_payload_bytes) {
+        hash = inline_payload(dest_addr, bytes);
+      } else if (find_constant_pattern(dest_addr, bytes, pattern)) {
+        hash = constant_fingerprint(pattern);
+      } else if (use_sparse_hash(bytes)) {
+        hash = sparse_hash_buffer(dest_addr, bytes);
+      } else {
+        hash = hash_buffer(dest_addr, bytes);
+      }
+    }
+    if (is_transfer_op(optype) && bytes > k_inline_payload_bytes) {
+      profiler.end_hash(bytes);
+    }
+
+    profiler.begin_phase();
+    if (s_online) {
+      stream_record_transfer({optype, src_addr, dest_addr, src_device_num,
+                              dest_device_num, bytes, codeptr_ra, target_id,
+                              start_time, time_now, hash});
+    } else if (!get_thread_log()->data_op_log.emplace_back(
+                   optype, src_addr, dest_addr, src_device_num,
+                   dest_device_num, bytes, codeptr_ra, target_id, start_time,
+                   time_now, hash)) {
+      warn_event_dropped();
     }
+    profiler.end_phase(k_phase_log);
+
+    // inline payloads and the fingerprints of constant data cannot collide
+    if (CheckCollisions && bytes > k_inline_payload_bytes &&
+        !is_constant_fingerprint(hash, bytes)) {
+      if (is_transfer_to_op(optype)) {
+        check_collisions(hash, src_addr, bytes);
+      } else if (is_transfer_from_op(optype)) {
+        check_collisions(hash, dest_addr, bytes);
+      }
+    }
+  }
 
+  return;
+}
+
+/* Data op callback of counters only mode, which only times the data ops (see
+ * s_counters).
+ */
+template <bool Profile>
+static void on_ompt_callback_target_data_op_counters(
+    ompt_scope_endpoint_t endpoint, ompt_data_t *target_task_data,
+    ompt_data_t *target_data, ompt_id_t *host_op_id,
+    ompt_target_data_op_t optype, void *src_addr, int src_device_num,
+    void *dest_addr, int dest_device_num, size_t bytes,
+    const void *codeptr_ra) {
+  // used to time synchronous data ops
+  static thread_local steady_clock::time_point s_sync_start_time =
+      steady_clock::time_point();
+
+  if (!(is_transfer_op(optype) || is_alloc_op(optype) ||
+        is_delete_op(optype))) {
+    return;
+  }
+
+  const steady_clock::time_point time_now = ToolClock::now();
+  CallbackProfiler<Profile> profiler(time_now);
+
+  bool is_async = is_async_op(optype);
+  if (endpoint == ompt_scope_begin) {
+    // commit start timestamp
+    if (is_async) {
+      assert(host_op_id != nullptr);
+      if (host_op_id != nullptr) {
+        *host_op_id = begin_async_op({time_now, nullptr, true, false, 0});
+      }
+    } else {
+      s_sync_start_time = time_now;
+    }
+
+  } else if (endpoint == ompt_scope_end) {
+    // commit end timestamp
     steady_clock::time_point start_time;
     if (is_async) {
-      const std::pair<int, const void *> key(dest_device_num, dest_addr);
-      assert(s_async_data_op_start_times.contains(key));
-      start_time = s_async_data_op_start_times[key];
-      s_async_data_op_start_times.erase(key);
+      assert(host_op_id != nullptr);
+      start_time =
+          end_async_op(host_op_id != nullptr ? *host_op_id : 0, time_now)
+              .start_time;
     } else {
-      start_time = s_sync_data_op_start_time;
-    }
-    s_data_op_log_mutex.lock();
-    s_data_op_log_ptr->emplace_back(optype, src_addr, dest_addr, src_device_num,
-                                    dest_device_num, bytes, codeptr_ra,
-                                    start_time, time_now, hash);
-    s_data_op_log_mutex.unlock();
-
-#ifdef ENABLE_COLLISION_CHECKING
-    s_collision_map_mutex.lock();
-    if (is_transfer_to_op(optype)) {
-      try_collision_map_insert(s_collision_map_ptr, hash, src_addr, bytes);
-    } else if (is_transfer_from_op(optype)) {
-      try_collision_map_insert(s_collision_map_ptr, hash, dest_addr, bytes);
+      start_time = s_sync_start_time;
     }
-    s_collision_map_mutex.unlock();
-#endif // ENABLE_COLLISION_CHECKING
+    profiler.begin_phase();
+    record_site_stats(codeptr_ra, optype, bytes, time_now - start_time);
+    profiler.end_phase(k_phase_log);
   }
 
   return;
 }
 
+template <bool Profile>
+static void on_ompt_callback_target_submit_emi(
+    ompt_scope_endpoint_t endpoint, ompt_data_t *target_data,
+    ompt_id_t *host_op_id, unsigned int requested_num_teams) {
+  // kernels are submitted synchronously by the thread running the target task
+  static thread_local steady_clock::time_point s_submit_start_time =
+      steady_clock::time_point();
+  // ids of the submissions, which the device trace records carry (see
+  // device_trace.hh), zero is left for submissions without one
+  static std::atomic<uint64_t> s_next_host_op_id = 1;
+
+  const steady_clock::time_point time_now = ToolClock::now();
+  CallbackProfiler<Profile> profiler(time_now);
+
+  if (endpoint == ompt_scope_begin) {
+    s_submit_start_time = time_now;
+    if (host_op_id != nullptr) {
+      *host_op_id = s_next_host_op_id.fetch_add(1, std::memory_order_relaxed);
+    }
+  } else if (endpoint == ompt_scope_end) {
+    const uint64_t target_id = target_data != nullptr ? target_data->value : 0;
+    const uint64_t op_id = host_op_id != nullptr ? *host_op_id : 0;
+    profiler.begin_phase();
+    if (!get_thread_log()->kernel_log.emplace_back(target_id,
+                                                   requested_num_teams,
+                                                   s_submit_start_time,
+                                                   time_now, op_id)) {
+      warn_event_dropped();
+    }
+    profiler.end_phase(k_phase_log);
+  }
+
+  return;
+}
+
+static void on_ompt_callback_device_initialize(int device_num,
+                                               const char *type,
+                                               ompt_device_t *device,
+                                               ompt_function_lookup_t lookup,
+                                               const char *documentation) {
+  if (!device_trace_start(device_num, device, lookup)) {
+    std::cerr << "warning: kernels cannot be traced on device " << device_num
+              << ", their kernel time is the span of their submit events.\n";
+  } else if (s_verbose) {
+    std::cerr << "info: tracing kernels on device " << device_num << "\n";
+  }
+  return;
+}
+
+static void on_ompt_callback_device_finalize(int device_num) {
+  device_trace_stop(device_num);
+  return;
+}
+
+/* Registers the variant of the callbacks for the given modes. Returns false
+ * if a required callback cannot be registered.
+ */
+template <bool Profile, bool CheckCollisions>
+static bool register_callbacks() {
+  ompt_set_result_t result = ompt_set_error;
+  result = ompt_set_callback(
+      ompt_callback_target_data_op_emi,
+      reinterpret_cast<ompt_callback_t>(
+          on_ompt_callback_target_data_op_emi<Profile, CheckCollisions>));
+  if (result != ompt_set_always) {
+    return false;
+  }
+  // online mode keeps no event log, so target regions and kernels are not
+  // traced
+  if (s_online) {
+    return true;
+  }
+  result = ompt_set_callback(
+      ompt_callback_target_emi,
+      reinterpret_cast<ompt_callback_t>(on_ompt_callback_target_emi<Profile>));
+  if (result != ompt_set_always) {
+    return false;
+  }
+  // optional, without it the kernel time of each region is not reported
+  result = ompt_set_callback(ompt_callback_target_submit_emi,
+                             reinterpret_cast<ompt_callback_t>(
+                                 on_ompt_callback_target_submit_emi<Profile>));
+  if (result != ompt_set_always) {
+    std::cerr << "warning: kernel submissions cannot be traced, kernel times "
+                 "will not be reported.\n";
+    return true;
+  }
+  // optional, without device tracing the kernel time of each region is the
+  // span of its submit events
+  ompt_set_callback(ompt_callback_device_initialize,
+                    reinterpret_cast<ompt_callback_t>(
+                        on_ompt_callback_device_initialize));
+  ompt_set_callback(
+      ompt_callback_device_finalize,
+      reinterpret_cast<ompt_callback_t>(on_ompt_callback_device_finalize));
+  return true;
+}
+
+/* Registers the callbacks of counters only mode, only data ops are traced.
+ * Returns false if the data op callback cannot be registered.
+ */
+template <bool Profile>
+static bool register_counters_callbacks() {
+  const ompt_set_result_t result = ompt_set_callback(
+      ompt_callback_target_data_op_emi,
+      reinterpret_cast<ompt_callback_t>(
+          on_ompt_callback_target_data_op_counters<Profile>));
+  return result == ompt_set_always;
+}
+
 /* OpenMP API Specification 5.2 Section 19.2.3
  * "If a tool initializer returns a non-zero value, the OMPT interface state
  * remains active for the execution; otherwise, the OMPT interface state
@@ -319,26 +1153,81 @@ int ompt_initialize(ompt_function_lookup_t lookup, int initial_device_num,
     return 0;
   }
 
-  ompt_set_result_t result = ompt_set_error;
-  result = ompt_set_callback(
-      ompt_callback_target_data_op_emi,
-      reinterpret_cast<ompt_callback_t>(on_ompt_callback_target_data_op_emi));
-  if (result != ompt_set_always) {
-    return 0;
+  init_modes();
+  if (!s_counters) {
+    init_sampling();
+    init_online();
   }
-  result = ompt_set_callback(
-      ompt_callback_target_emi,
-      reinterpret_cast<ompt_callback_t>(on_ompt_callback_target_emi));
-  if (result != ompt_set_always) {
+  const bool any_collision_check = s_check_collisions || s_verify_hashes;
+  if (s_counters) {
+    if (profile_enabled()) {
+      if (!register_counters_callbacks<true>()) {
+        return 0;
+      }
+    } else if (!register_counters_callbacks<false>()) {
+      return 0;
+    }
+  } else if (profile_enabled()) {
+    if (any_collision_check) {
+      if (!register_callbacks<true, true>()) {
+        return 0;
+      }
+    } else if (!register_callbacks<true, false>()) {
+      return 0;
+    }
+  } else if (any_collision_check) {
+    if (!register_callbacks<false, true>()) {
+      return 0;
+    }
+  } else if (!register_callbacks<false, false>()) {
     return 0;
   }
 
+  ToolClock::init(getenv_str_equals("OMPDATAPERF_CLOCK", "tsc"));
+  if (s_counters) {
+    // nothing is hashed, so the hash function and helper threads are not set
+    // up at all
+    std::cerr << "info: counters only mode, data transfers are neither "
+                 "hashed nor logged.\n";
+    s_profile_start_time = ToolClock::now();
+    s_start_time = steady_clock::now();
+    return 1;
+  }
+  s_trace_path = getenv("OMPDATAPERF_TRACE");
+  s_trace_only =
+      s_trace_path != nullptr && getenv_bool("OMPDATAPERF_TRACE_ONLY");
+  hash_init(getenv("OMPDATAPERF_HASH"), getenv_hash_bits());
+  if (s_verbose) {
+    std::cerr << "info: hashing data transfers with "
+              << get_hash_backend().name << " (" << get_hash_backend().bits
+              << " bit)\n";
+  }
+  if (s_verify_hashes) {
+    hash_verify_init();
+  }
+  if (getenv_bool("OMPDATAPERF_HASH_CACHE")) {
+    hash_cache_init();
+  }
+  init_sparse_hash();
+  init_streaming_hash();
+  start_hash_pool();
+  s_profile_start_time = ToolClock::now();
   s_start_time = steady_clock::now();
   return 1;
 }
-#include <algorithm>
 void ompt_finalize(ompt_data_t *data) {
   s_end_time = steady_clock::now();
+  if (profile_enabled()) {
+    profile_sample_memory(ToolClock::now());
+  }
+  ToolClock::calibrate();
+  device_trace_stop_all();
+  hash_pool_shutdown();
+  arena_spill_shutdown();
+  tool_profile_t profile = {};
+  if (profile_enabled()) {
+    merge_thread_profiles(profile);
+  }
 
   const steady_clock::time_point analysis_start = steady_clock::now();
 
@@ -346,40 +1235,102 @@ void ompt_finalize(ompt_data_t *data) {
   const duration<uint64_t, std::nano> exec_time = s_end_time - s_start_time;
   const int num_devices = ompt_get_num_devices();
 
-  // ensure that event logs are in chronological order
-  std::sort(s_target_log_ptr->begin(), s_target_log_ptr->end(),
-            [](const target_info_t &a, const target_info_t &b) {
-              if (a.start_time != b.start_time) {
-                return a.start_time < b.start_time;
-              }
-              return a.end_time < b.end_time;
-            });
-  std::sort(s_data_op_log_ptr->begin(), s_data_op_log_ptr->end(),
-            [](const data_op_info_t &a, const data_op_info_t &b) {
-              if (a.start_time != b.start_time) {
-                return a.start_time < b.start_time;
-              }
-              return a.end_time < b.end_time;
-            });
+  if (arena_bytes_spilled() > 0) {
+    std::cerr << "\ninfo: " << arena_bytes_spilled()
+              << " bytes of the event log were spilled to disk.\n";
+  }
+  if (s_sparse_hash_bytes != 0) {
+    print_sparse_hash_summary();
+  }
+  // the size of the logs as they were held while the program ran
+  size_t log_event_bytes = 0;
+  size_t log_resident_bytes = 0;
+  if (s_print_space_overhead) {
+    get_thread_logs_bytes(&log_event_bytes, &log_resident_bytes);
+  }
+  merge_thread_logs(s_target_log_ptr, s_data_op_log_ptr, s_kernel_log_ptr);
+  if (keep_site_stats()) {
+    merge_thread_site_stats(s_site_stats_ptr);
+    for (data_op_site_stats_t &stats : *s_site_stats_ptr) {
+      stats.time = ToolClock::to_steady(stats.time);
+      stats.min_time = ToolClock::to_steady(stats.min_time);
+      stats.max_time = ToolClock::to_steady(stats.max_time);
+    }
+  }
+  // events hold raw timestamps until now
+  for (target_info_t &entry : *s_target_log_ptr) {
+    entry.start_time = ToolClock::to_steady(entry.start_time);
+    entry.end_time = ToolClock::to_steady(entry.end_time);
+  }
+  for (data_op_info_t &entry : *s_data_op_log_ptr) {
+    entry.start_time = ToolClock::to_steady(entry.start_time);
+    entry.end_time = ToolClock::to_steady(entry.end_time);
+  }
+  for (kernel_info_t &entry : *s_kernel_log_ptr) {
+    entry.start_time = ToolClock::to_steady(entry.start_time);
+    entry.end_time = ToolClock::to_steady(entry.end_time);
+  }
+
+  if (s_trace_path != nullptr) {
+    if (s_online) {
+      std::cerr << "warning: a trace cannot be written in online mode.\n";
+    } else {
+      trace_info_t info = {num_devices,
+                           exec_time,
+                           s_sample_period,
+                           s_sample_random,
+                           get_hash_backend().name,
+                           get_hash_backend().bits,
+                           read_proc_maps()};
+      write_trace(s_trace_path, info, s_target_log_ptr, s_data_op_log_ptr,
+                  s_kernel_log_ptr, s_site_stats_ptr);
+    }
+  }
 
   Symbolizer symbolizer;
-  analyze_inefficient_transfers(symbolizer, s_target_log_ptr, s_data_op_log_ptr,
-                                exec_time, num_devices);
-  analyze_codeptr_durations(symbolizer, s_data_op_log_ptr, exec_time);
-  print_summary(s_data_op_log_ptr, exec_time);
-#ifdef ENABLE_COLLISION_CHECKING
-  print_collision_summary(s_collision_map_ptr);
-  free_data(s_collision_map_ptr);
-#endif
-#ifdef MEASURE_HASHING_OVERHEAD
-  print_hash_overhead_summary(s_data_op_log_ptr, s_hash_overhead);
-#endif
-#ifdef PRINT_SPACE_OVERHEAD
-print_space_overhead_summary(s_target_log_ptr, s_data_op_log_ptr);
-#endif
-#ifdef PRINT_TRANSFER_RATE
-  print_transfer_rate_summary(s_data_op_log_ptr);
-#endif
+  if (s_counters) {
+    analyze_codeptr_durations(symbolizer, s_site_stats_ptr, exec_time);
+    print_summary(s_site_stats_ptr, exec_time);
+  } else if (!s_trace_only) {
+    stream_results_t stream_results;
+    if (s_online) {
+      stream_collect(stream_results);
+    }
+    run_analysis(symbolizer, s_target_log_ptr, s_data_op_log_ptr,
+                 s_kernel_log_ptr, s_site_stats_ptr, exec_time, num_devices,
+                 s_sample_period, s_sample_random,
+                 s_online ? &stream_results : nullptr);
+  }
+  if (s_check_collisions || s_verify_hashes || s_measure_hashing) {
+    // the function actually used, which is not the one requested if that
+    // one was unknown or unsupported
+    std::cerr << "\n  hash function  " << get_hash_backend().name << " ("
+              << get_hash_backend().bits << " bit)\n";
+  }
+  if (s_check_collisions) {
+    print_collision_summary(s_collision_map_ptr);
+    free_data(s_collision_map_ptr);
+  }
+  if (s_verify_hashes) {
+    print_hash_verify_summary();
+    hash_verify_shutdown();
+  }
+  if (s_measure_hashing) {
+    print_hash_overhead_summary(
+        s_data_op_log_ptr,
+        ToolClock::to_steady(
+            duration<uint64_t, std::nano>(profile.time[k_phase_hash])));
+  }
+  if (s_print_space_overhead) {
+    print_space_overhead_summary(log_event_bytes, log_resident_bytes);
+  }
+  if (s_print_transfer_rate) {
+    print_transfer_rate_summary(s_data_op_log_ptr);
+  }
+  if (s_self_profile) {
+    print_self_profile_summary(profile, hash_pool_cpu_time(),
+                               arena_spill_cpu_time(), s_profile_start_time);
+  }
   const steady_clock::time_point analysis_end = steady_clock::now();
   const duration<uint64_t, std::nano> analysis_time =
       analysis_end - analysis_start;
@@ -397,9 +1348,9 @@ print_space_overhead_summary(s_target_log_ptr, s_data_op_log_ptr);
 
   delete s_target_log_ptr;
   delete s_data_op_log_ptr;
-#ifdef ENABLE_COLLISION_CHECKING
+  delete s_kernel_log_ptr;
+  delete s_site_stats_ptr;
   delete s_collision_map_ptr;
-#endif // ENABLE_COLLISION_CHECKING
 
   if (data != nullptr && data->ptr != nullptr) {
     ompt_start_tool_result_t *result =
@@ -435,11 +1386,15 @@ ompt_start_tool(unsigned int omp_version, const char *runtime_version) {
               << ". Some features may be degraded.\n";
   }
 
-  s_target_log_ptr = new std::vector<target_info_t>();
-  s_data_op_log_ptr = new std::vector<data_op_info_t>();
-#ifdef ENABLE_COLLISION_CHECKING
-  s_collision_map_ptr = new std::map<HASH_T, std::set<data_info_t>>();
-#endif // ENABLE_COLLISION_CHECKING
+  arena_init(getenv_bool("OMPDATAPERF_HUGE_PAGES"));
+  init_spill();
+  op_table_init(k_op_table_capacity);
+  // the merged logs are kept in the spill file if there is a memory budget
+  s_target_log_ptr = new std::pmr::vector<target_info_t>(arena_log_resource());
+  s_data_op_log_ptr =
+      new std::pmr::vector<data_op_info_t>(arena_log_resource());
+  s_kernel_log_ptr = new std::pmr::vector<kernel_info_t>(arena_log_resource());
+  s_site_stats_ptr = new std::vector<data_op_site_stats_t>();
   ompt_start_tool_result_t *result = new ompt_start_tool_result_t;
   result->initialize = ompt_initialize;
   result->finalize = ompt_finalize;
@@ -0,0 +1,457 @@
+#include "trace.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "packed_record.hh"
+
+using namespace std::chrono;
+
+// packed data op records hold steady_clock ticks, traces store nanoseconds
+static_assert(std::is_same_v<steady_clock::period, std::nano>);
+
+namespace {
+constexpr size_t k_trace_buffer_bytes = 1024 * 1024;
+
+bool write_all(int fd, const void *data, size_t bytes) {
+  size_t done = 0;
+  while (done < bytes) {
+    const ssize_t ret =
+        write(fd, static_cast<const char *>(data) + done, bytes - done);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return false;
+    }
+    done += ret;
+  }
+  return true;
+}
+
+/* Buffers the encoded trace and writes it to a file descriptor. After a write
+ * fails, everything else is dropped and ok() returns false.
+ */
+class TraceWriter {
+private:
+  int m_fd;
+  bool m_ok = true;
+  std::vector<unsigned char> m_buffer;
+  size_t m_pos = 0;
+
+public:
+  explicit TraceWriter(int fd) : m_fd(fd), m_buffer(k_trace_buffer_bytes) {}
+
+  bool ok() const { return m_ok; }
+
+  bool flush() {
+    m_ok = m_ok && write_all(m_fd, m_buffer.data(), m_pos);
+    m_pos = 0;
+    return m_ok;
+  }
+
+  /* Returns a pointer to at least 'bytes' bytes of buffer space.
+   */
+  unsigned char *reserve(size_t bytes) {
+    if (m_pos + bytes > m_buffer.size()) {
+      flush();
+    }
+    return m_buffer.data() + m_pos;
+  }
+
+  void commit(unsigned char *end) { m_pos = end - m_buffer.data(); }
+
+  void write_bytes(const void *data, size_t bytes) {
+    if (bytes > m_buffer.size() - m_pos) {
+      flush();
+      m_ok = m_ok && write_all(m_fd, data, bytes);
+      return;
+    }
+    memcpy(m_buffer.data() + m_pos, data, bytes);
+    m_pos += bytes;
+  }
+
+  void write_varint(uint64_t value) {
+    commit(put_varint(reserve(k_max_varint_bytes), value));
+  }
+
+  void write_string(const std::string &value) {
+    write_varint(value.size());
+    write_bytes(value.data(), value.size());
+  }
+};
+
+/* Decodes a trace mapped in memory. Reads past the end of the trace yield
+ * zeros and clear ok(), so a truncated or corrupt trace is detected without
+ * checking every field.
+ */
+class TraceReader {
+private:
+  const unsigned char *m_p;
+  const unsigned char *m_end;
+  bool m_ok = true;
+
+  /* Decodes a record with 'decode' from a zero padded copy of the end of the
+   * trace, which is shorter than the longest possible record.
+   */
+  template <typename Decode> void decode_tail(Decode &&decode) {
+    unsigned char tail[k_max_packed_record_bytes] = {};
+    const size_t left = m_end - m_p;
+    memcpy(tail, m_p, left);
+    const size_t used = decode(tail) - tail;
+    if (used > left) {
+      m_ok = false;
+      m_p = m_end;
+    } else {
+      m_p += used;
+    }
+  }
+
+public:
+  TraceReader(const unsigned char *begin, const unsigned char *end)
+      : m_p(begin), m_end(end) {}
+
+  bool ok() const { return m_ok; }
+  size_t remaining() const { return m_end - m_p; }
+
+  bool read_bytes(void *data, size_t bytes) {
+    if (bytes > remaining()) {
+      m_ok = false;
+      m_p = m_end;
+      return false;
+    }
+    memcpy(data, m_p, bytes);
+    m_p += bytes;
+    return true;
+  }
+
+  uint64_t read_varint() {
+    uint64_t value = 0;
+    if (remaining() >= k_max_varint_bytes) [[likely]] {
+      m_p = get_varint(m_p, value);
+    } else {
+      decode_tail([&value](const unsigned char *p) {
+        return get_varint(p, value);
+      });
+    }
+    return value;
+  }
+
+  void read_string(std::string &value) {
+    const uint64_t size = read_varint();
+    if (size > remaining()) {
+      m_ok = false;
+      m_p = m_end;
+      return;
+    }
+    value.assign(reinterpret_cast<const char *>(m_p), size);
+    m_p += size;
+  }
+
+  /* Returns the number of records of a section, every record takes at least
+   * one byte.
+   */
+  uint64_t read_count() {
+    const uint64_t count = read_varint();
+    if (count > remaining()) {
+      m_ok = false;
+      return 0;
+    }
+    return count;
+  }
+
+  void read_data_op(data_op_info_t &info, uint64_t &site_index,
+                    size_t hash_bytes, packed_state_t &state) {
+    if (remaining() >= k_max_packed_record_bytes) [[likely]] {
+      m_p = unpack_data_op(m_p, info, site_index, hash_bytes, state);
+    } else {
+      decode_tail([&](const unsigned char *p) {
+        return unpack_data_op(p, info, site_index, hash_bytes, state);
+      });
+    }
+  }
+};
+
+int64_t count_ns(steady_clock::time_point time) {
+  return duration_cast<nanoseconds>(time.time_since_epoch()).count();
+}
+
+steady_clock::time_point from_ns(int64_t ns) {
+  return steady_clock::time_point(
+      duration_cast<steady_clock::duration>(nanoseconds(ns)));
+}
+
+/* Call site table of a trace, mapping each codeptr_ra to its index.
+ */
+class SiteTable {
+private:
+  std::vector<const void *> m_sites;
+  std::unordered_map<const void *, uint32_t> m_index;
+
+public:
+  void add(const void *codeptr_ra) {
+    if (m_index.try_emplace(codeptr_ra, m_sites.size()).second) {
+      m_sites.push_back(codeptr_ra);
+    }
+  }
+
+  uint32_t index(const void *codeptr_ra) const {
+    return m_index.at(codeptr_ra);
+  }
+
+  const std::vector<const void *> &sites() const { return m_sites; }
+};
+} // namespace
+
+std::string read_proc_maps() {
+  std::ifstream maps("/proc/self/maps");
+  std::string result;
+  std::string line;
+  while (std::getline(maps, line)) {
+    // only file backed mappings can be symbolized in another process
+    if (line.find(" /") != std::string::npos) {
+      result += line;
+      result += '\n';
+    }
+  }
+  return result;
+}
+
+bool write_trace(const char *path, const trace_info_t &info,
+                 const std::pmr::vector<target_info_t> *target_log_ptr,
+                 const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                 const std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                 const std::vector<data_op_site_stats_t> *site_stats_ptr) {
+  SiteTable sites;
+  const void *last_site = nullptr;
+  for (const target_info_t &entry : *target_log_ptr) {
+    sites.add(entry.codeptr_ra);
+  }
+  for (const data_op_info_t &entry : *data_op_log_ptr) {
+    // most data ops repeat the call site of the previous one
+    if (entry.codeptr_ra != last_site || sites.sites().empty()) {
+      sites.add(entry.codeptr_ra);
+      last_site = entry.codeptr_ra;
+    }
+  }
+  for (const data_op_site_stats_t &stats : *site_stats_ptr) {
+    sites.add(stats.codeptr_ra);
+  }
+
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "warning: failed to create trace file '" << path << "'. "
+              << strerror(errno) << "\n";
+    return false;
+  }
+  TraceWriter out(fd);
+  out.write_bytes(k_trace_magic, sizeof(k_trace_magic));
+  out.write_varint(k_trace_version);
+  out.write_varint(zigzag(info.num_devices));
+  out.write_varint(info.exec_time.count());
+  out.write_varint(info.sample_period);
+  out.write_varint(info.sample_random);
+  out.write_varint(info.hash_bits);
+  out.write_string(info.hash_name);
+  out.write_string(info.maps);
+
+  out.write_varint(sites.sites().size());
+  for (const void *codeptr_ra : sites.sites()) {
+    out.write_varint(reinterpret_cast<uintptr_t>(codeptr_ra));
+  }
+
+  int64_t prev_start = 0;
+  out.write_varint(target_log_ptr->size());
+  for (const target_info_t &entry : *target_log_ptr) {
+    const int64_t start = count_ns(entry.start_time);
+    out.write_varint(entry.kind);
+    out.write_varint(zigzag(entry.device_num));
+    out.write_varint(entry.target_id);
+    out.write_varint(sites.index(entry.codeptr_ra));
+    out.write_varint(zigzag(start - prev_start));
+    out.write_varint(zigzag(count_ns(entry.end_time) - start));
+    prev_start = start;
+  }
+
+  const size_t hash_bytes = packed_hash_width(info.hash_bits);
+  packed_state_t state = {};
+  uint32_t last_index = 0;
+  last_site = nullptr;
+  out.write_varint(data_op_log_ptr->size());
+  for (const data_op_info_t &entry : *data_op_log_ptr) {
+    if (entry.codeptr_ra != last_site || last_site == nullptr) {
+      last_index = sites.index(entry.codeptr_ra);
+      last_site = entry.codeptr_ra;
+    }
+    unsigned char *const p = out.reserve(k_max_packed_record_bytes);
+    out.commit(pack_data_op(p, entry, last_index, hash_bytes, state));
+  }
+
+  prev_start = 0;
+  out.write_varint(kernel_log_ptr->size());
+  for (const kernel_info_t &entry : *kernel_log_ptr) {
+    const int64_t start = count_ns(entry.start_time);
+    out.write_varint(entry.target_id);
+    out.write_varint(entry.requested_num_teams);
+    out.write_varint(zigzag(start - prev_start));
+    out.write_varint(zigzag(count_ns(entry.end_time) - start));
+    out.write_varint(entry.exec_time.count());
+    prev_start = start;
+  }
+
+  out.write_varint(site_stats_ptr->size());
+  for (const data_op_site_stats_t &stats : *site_stats_ptr) {
+    out.write_varint(sites.index(stats.codeptr_ra));
+    out.write_varint(stats.optype);
+    out.write_varint(stats.calls);
+    out.write_varint(stats.bytes);
+    out.write_varint(stats.time.count());
+    out.write_varint(stats.min_time.count());
+    out.write_varint(stats.max_time.count());
+  }
+
+  const bool ok = out.flush();
+  if (!ok) {
+    std::cerr << "warning: failed to write trace file '" << path << "'. "
+              << strerror(errno) << "\n";
+  }
+  close(fd);
+  return ok;
+}
+
+bool read_trace(const char *path, trace_info_t &info,
+                std::pmr::vector<target_info_t> *target_log_ptr,
+                std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                std::vector<data_op_site_stats_t> *site_stats_ptr) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "error: failed to open trace file '" << path << "'. "
+              << strerror(errno) << "\n";
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(k_trace_magic)) {
+    std::cerr << "error: '" << path << "' is not a trace file.\n";
+    close(fd);
+    return false;
+  }
+  const size_t file_bytes = st.st_size;
+  void *mapping = mmap(nullptr, file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "error: failed to map trace file '" << path << "'. "
+              << strerror(errno) << "\n";
+    return false;
+  }
+  madvise(mapping, file_bytes, MADV_SEQUENTIAL);
+  const unsigned char *trace = static_cast<const unsigned char *>(mapping);
+  TraceReader in(trace, trace + file_bytes);
+
+  char magic[sizeof(k_trace_magic)];
+  in.read_bytes(magic, sizeof(magic));
+  if (memcmp(magic, k_trace_magic, sizeof(magic)) != 0) {
+    std::cerr << "error: '" << path << "' is not a trace file.\n";
+    munmap(mapping, file_bytes);
+    return false;
+  }
+  const uint64_t version = in.read_varint();
+  if (version != k_trace_version) {
+    std::cerr << "error: unsupported trace version " << version
+              << " (expected " << k_trace_version << ").\n";
+    munmap(mapping, file_bytes);
+    return false;
+  }
+
+  info.num_devices = unzigzag(in.read_varint());
+  info.exec_time = duration<uint64_t, std::nano>(in.read_varint());
+  info.sample_period = in.read_varint();
+  info.sample_random = in.read_varint() != 0;
+  info.hash_bits = in.read_varint();
+  in.read_string(info.hash_name);
+  in.read_string(info.maps);
+
+  std::vector<const void *> sites(in.read_count());
+  for (const void *&codeptr_ra : sites) {
+    codeptr_ra = reinterpret_cast<const void *>(in.read_varint());
+  }
+  // returns the call site at 'index', or null if the trace is corrupt
+  const auto site = [&sites](uint64_t index) -> const void * {
+    return index < sites.size() ? sites[index] : nullptr;
+  };
+
+  int64_t prev_start = 0;
+  uint64_t count = in.read_count();
+  target_log_ptr->reserve(target_log_ptr->size() + count);
+  for (uint64_t i = 0; i < count && in.ok(); ++i) {
+    target_info_t entry;
+    entry.kind = static_cast<ompt_target_t>(in.read_varint());
+    entry.device_num = unzigzag(in.read_varint());
+    entry.target_id = in.read_varint();
+    entry.codeptr_ra = site(in.read_varint());
+    const int64_t start = prev_start + unzigzag(in.read_varint());
+    entry.start_time = from_ns(start);
+    entry.end_time = from_ns(start + unzigzag(in.read_varint()));
+    prev_start = start;
+    target_log_ptr->push_back(entry);
+  }
+
+  const size_t hash_bytes = packed_hash_width(info.hash_bits);
+  packed_state_t state = {};
+  count = in.read_count();
+  data_op_log_ptr->reserve(data_op_log_ptr->size() + count);
+  for (uint64_t i = 0; i < count && in.ok(); ++i) {
+    data_op_info_t entry;
+    uint64_t site_index;
+    in.read_data_op(entry, site_index, hash_bytes, state);
+    entry.codeptr_ra = site(site_index);
+    data_op_log_ptr->push_back(entry);
+  }
+
+  prev_start = 0;
+  count = in.read_count();
+  kernel_log_ptr->reserve(kernel_log_ptr->size() + count);
+  for (uint64_t i = 0; i < count && in.ok(); ++i) {
+    kernel_info_t entry;
+    entry.target_id = in.read_varint();
+    entry.requested_num_teams = in.read_varint();
+    const int64_t start = prev_start + unzigzag(in.read_varint());
+    entry.start_time = from_ns(start);
+    entry.end_time = from_ns(start + unzigzag(in.read_varint()));
+    entry.host_op_id = 0;
+    entry.exec_time = nanoseconds(in.read_varint());
+    prev_start = start;
+    kernel_log_ptr->push_back(entry);
+  }
+
+  count = in.read_count();
+  site_stats_ptr->reserve(site_stats_ptr->size() + count);
+  for (uint64_t i = 0; i < count && in.ok(); ++i) {
+    data_op_site_stats_t stats;
+    stats.codeptr_ra = site(in.read_varint());
+    stats.optype = static_cast<ompt_target_data_op_t>(in.read_varint());
+    stats.calls = in.read_varint();
+    stats.bytes = in.read_varint();
+    stats.time = duration<uint64_t, std::nano>(in.read_varint());
+    stats.min_time = duration<uint64_t, std::nano>(in.read_varint());
+    stats.max_time = duration<uint64_t, std::nano>(in.read_varint());
+    site_stats_ptr->push_back(stats);
+  }
+  munmap(mapping, file_bytes);
+
+  if (!in.ok()) {
+    std::cerr << "error: trace file '" << path
+              << "' is truncated or corrupt.\n";
+    return false;
+  }
+  return true;
+}
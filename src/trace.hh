@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "analyze.hh"
+
+/* A trace file holds the merged event logs of a profiled run along with what
+ * is needed to analyze them elsewhere: the number of devices, the execution
+ * time, the sampling configuration and the memory map of the process, so that
+ * call sites can be symbolized from the binaries and shared libraries it
+ * loaded.
+ *
+ * Layout:
+ *   magic                       k_trace_magic
+ *   version                     varint
+ *   num_devices                 zigzag varint
+ *   exec_time                   varint, nanoseconds
+ *   sample_period               varint
+ *   sample_random               varint
+ *   hash_bits                   varint
+ *   hash_name                   string
+ *   maps                        string, lines of /proc/self/maps
+ *   call sites                  varint count, then a varint codeptr_ra each
+ *   targets                     varint count, then a target record each
+ *   data ops                    varint count, then a packed record each
+ *   kernels                     varint count, then a kernel record each
+ *   site stats                  varint count, then a site stats record each
+ * Strings are a varint length followed by their bytes. Data ops use the
+ * encoding of packed_record.hh, with hashes stored on hash_bits / 8 bytes,
+ * the other records are
+ *   target      kind, zigzag device_num, target_id, call site index, zigzag
+ *               start_time delta from the previous target, zigzag end_time
+ *               delta from start_time
+ *   kernel      target_id, requested_num_teams, zigzag start_time delta from
+ *               the previous kernel, zigzag end_time delta from start_time,
+ *               exec_time in nanoseconds
+ *   site stats  call site index, optype, calls, bytes, time, min_time,
+ *               max_time, the times in nanoseconds
+ * all of them varints. Codeptrs are indices into the call site table. The
+ * format does not depend on the layout of the records in memory, only on
+ * k_trace_version, which changes whenever the format does.
+ */
+
+constexpr char k_trace_magic[8] = {'O', 'M', 'P', 'D', 'P', 'T', 'R', 'C'};
+constexpr uint32_t k_trace_version = 6;
+
+/* Everything in a trace other than the event logs.
+ */
+typedef struct trace_info {
+  int num_devices;
+  std::chrono::duration<uint64_t, std::nano> exec_time;
+  uint64_t sample_period;
+  bool sample_random;
+  std::string hash_name;
+  unsigned int hash_bits;
+  // file backed mappings of the process in the format of /proc/self/maps
+  std::string maps;
+} trace_info_t;
+
+/* Returns the file backed mappings of the calling process in the format of
+ * /proc/self/maps.
+ */
+std::string read_proc_maps();
+
+/* Writes a trace to 'path'. The logs must hold steady_clock timestamps.
+ * Returns false, after printing a warning, if the trace cannot be written.
+ */
+bool write_trace(const char *path, const trace_info_t &info,
+                 const std::pmr::vector<target_info_t> *target_log_ptr,
+                 const std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                 const std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                 const std::vector<data_op_site_stats_t> *site_stats_ptr);
+
+/* Reads the trace at 'path', appending its event logs to the given vectors.
+ * Returns false, after printing an error, if the trace cannot be read or was
+ * written in another version of the format.
+ */
+bool read_trace(const char *path, trace_info_t &info,
+                std::pmr::vector<target_info_t> *target_log_ptr,
+                std::pmr::vector<data_op_info_t> *data_op_log_ptr,
+                std::pmr::vector<kernel_info_t> *kernel_log_ptr,
+                std::vector<data_op_site_stats_t> *site_stats_ptr);